@@ -0,0 +1,185 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/lattice_filter.h"
+
+using namespace ClickTrack;
+
+
+/* The per sample lattice loop as originally written in the vocalist. Every
+ * kernel must match it bit for bit.
+ */
+void reference_lattice(const std::vector<SAMPLE>& in, std::vector<SAMPLE>& out,
+        std::vector<float> reflection_coeffs,
+        const std::vector<float>& reflection_coeffs_delta, bool interpolating)
+{
+    unsigned num_coeffs = reflection_coeffs.size() - 1;
+    std::vector<SAMPLE> forward_errors(num_coeffs+1);
+    std::vector<SAMPLE> backward_errors(num_coeffs+1);
+
+    for(unsigned t = 0; t < in.size(); t++)
+    {
+        if(interpolating)
+        {
+            for(unsigned i = 1; i <= num_coeffs; i++)
+                reflection_coeffs[i] += reflection_coeffs_delta[i];
+        }
+
+        forward_errors[num_coeffs] = in[t];
+        for(unsigned i = num_coeffs; i > 0; i--)
+        {
+            forward_errors[i-1] = forward_errors[i] + 
+                reflection_coeffs[i] * backward_errors[i-1];
+            backward_errors[i] = -reflection_coeffs[i]*forward_errors[i-1] + 
+                backward_errors[i-1];
+        }
+
+        backward_errors[0] = forward_errors[0];
+        out[t] = forward_errors[0];
+    }
+}
+
+
+/* Reads the coefficients of a trained sound, with a zero in front to match
+ * the lattice layout
+ */
+std::vector<float> load_coeffs(std::string file)
+{
+    std::ifstream in(file.c_str());
+    std::string name;
+    float gain;
+    unsigned num_coeffs;
+    in >> name >> gain >> num_coeffs;
+
+    std::vector<float> coeffs(1, 0.0);
+    for(unsigned i = 0; i < num_coeffs; i++)
+    {
+        float c;
+        in >> c;
+        coeffs.push_back(c);
+    }
+    return coeffs;
+}
+
+
+/* Builds the interleaved state for a number of lanes, and runs the kernel.
+ * Each lane uses a different sound and excitation.
+ */
+void run_lanes(unsigned lanes, unsigned n,
+        const std::vector< std::vector<float> >& sounds,
+        const std::vector< std::vector<SAMPLE> >& inputs, bool interpolating,
+        std::vector<SAMPLE>& out)
+{
+    unsigned poles = sounds[0].size() - 1;
+    std::vector<float> k((poles+1)*lanes), dk((poles+1)*lanes);
+    std::vector<SAMPLE> b((poles+1)*lanes, 0.0), in(n*lanes);
+    for(unsigned l = 0; l < lanes; l++)
+    {
+        const std::vector<float>& from = sounds[l % sounds.size()];
+        const std::vector<float>& to = sounds[(l+1) % sounds.size()];
+        for(unsigned i = 0; i <= poles; i++)
+        {
+            k[i*lanes + l] = from[i];
+            dk[i*lanes + l] = (to[i] - from[i]) / n;
+        }
+        for(unsigned t = 0; t < n; t++)
+            in[t*lanes + l] = inputs[l % inputs.size()][t];
+    }
+
+    out.resize(n*lanes);
+    if(lanes == 1)
+        lattice_filter_scalar(&in[0], &out[0], n, poles, &k[0],
+                interpolating ? &dk[0] : NULL, &b[0]);
+    else
+        lattice_filter(&in[0], &out[0], n, poles, lanes, &k[0],
+                interpolating ? &dk[0] : NULL, &b[0]);
+}
+
+
+int main()
+{
+    using namespace std;
+
+    const char* names[] = { "A", "E", "I", "O", "U", "V", "Z", "L", "M", "N",
+        "T", "P", "K" };
+    vector< vector<float> > sounds;
+    for(unsigned i = 0; i < 13; i++)
+        sounds.push_back(load_coeffs(string("data/") + names[i] + ".dat"));
+
+    // Excite each lattice with a different pulse train
+    const unsigned n = 4096;
+    vector< vector<SAMPLE> > inputs;
+    for(unsigned p = 0; p < 8; p++)
+    {
+        vector<SAMPLE> input(n, 0.0);
+        for(unsigned t = 0; t < n; t += 100 + 13*p)
+            input[t] = 1.0;
+        inputs.push_back(input);
+    }
+
+    // Check every kernel against the original loop, bit for bit
+    bool failed = false;
+    const unsigned lane_counts[] = { 1, 3, 4, 8, 13, 16 };
+    for(unsigned c = 0; c < 6; c++)
+    {
+        for(unsigned interp = 0; interp < 2; interp++)
+        {
+            unsigned lanes = lane_counts[c];
+            vector<SAMPLE> out;
+            run_lanes(lanes, n, sounds, inputs, interp, out);
+
+            for(unsigned l = 0; l < lanes; l++)
+            {
+                const vector<float>& from = sounds[l % sounds.size()];
+                const vector<float>& to = sounds[(l+1) % sounds.size()];
+                vector<float> delta(from.size());
+                for(unsigned i = 0; i < from.size(); i++)
+                    delta[i] = (to[i] - from[i]) / n;
+
+                vector<SAMPLE> expected(n);
+                reference_lattice(inputs[l % inputs.size()], expected, from,
+                        delta, interp);
+
+                for(unsigned t = 0; t < n; t++)
+                {
+                    if(memcmp(&expected[t], &out[t*lanes + l],
+                                sizeof(SAMPLE)) != 0)
+                    {
+                        cerr << "MISMATCH lanes=" << lanes << " lane=" << l
+                            << " interpolating=" << interp << " t=" << t
+                            << endl;
+                        failed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    if(failed)
+        return 1;
+    cerr << "All kernels match the reference loop." << endl;
+
+    // Time each lane count
+    cout << "lanes,ns_per_voice_sample" << endl;
+    const unsigned timing_counts[] = { 1, 4, 8, 16, 32 };
+    for(unsigned c = 0; c < 5; c++)
+    {
+        unsigned lanes = timing_counts[c];
+        vector<SAMPLE> out;
+        unsigned reps = 20;
+
+        auto start = chrono::steady_clock::now();
+        for(unsigned r = 0; r < reps; r++)
+            run_lanes(lanes, n, sounds, inputs, false, out);
+        auto end = chrono::steady_clock::now();
+
+        double ns = chrono::duration<double, nano>(end - start).count();
+        cout << lanes << "," << ns / reps / n / lanes << endl;
+    }
+    cerr << "SIMD width on this CPU: " << lattice_simd_lanes() << endl;
+
+    return 0;
+}
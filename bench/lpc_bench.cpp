@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include "../src/lpc.h"
+
+using namespace ClickTrack;
+
+
+/* Checks and measures the autocorrelation used to train LPC models.
+ *
+ * For a range of lag counts, the FFT autocorrelation is checked against the
+ * direct sum, and both are timed. The largest error of any lag is printed
+ * relative to the zero lag. Streaming the signal in uneven pieces must give
+ * exactly the same result as adding it at once.
+ */
+
+
+/* Times a function of the signal and lags, in nanoseconds per sample
+ */
+template <class F>
+double time_per_sample(F function, const std::vector<float>& x)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() /
+        x.size();
+}
+
+
+int main()
+{
+    // Ten seconds of a buzzy vowel-like tone in noise
+    const unsigned long n = 441000;
+    std::vector<float> x(n);
+    srand(1);
+    for(unsigned long i = 0; i < n; i++)
+        x[i] = 0.5*sin(2*M_PI*220*i/44100) + 0.25*sin(2*M_PI*660*i/44100) +
+            0.1*((float) rand() / RAND_MAX - 0.5);
+
+    bool failed = false;
+    std::cout << "benchmark,ns_per_sample,max_relative_error" << std::endl;
+
+    const unsigned lags[] = { 8, 16, 32, 50, 100, 200, 400 };
+    for(unsigned i = 0; i < sizeof(lags)/sizeof(lags[0]); i++)
+    {
+        unsigned max_lag = lags[i];
+        std::vector<double> direct(max_lag + 1), fft(max_lag + 1),
+            streamed(max_lag + 1);
+
+        double direct_ns = time_per_sample([&]()
+        {
+            autocorrelate_direct(&x[0], n, max_lag, &direct[0]);
+        }, x);
+
+        Autocorrelator autocorrelator(max_lag);
+        double fft_ns = time_per_sample([&]()
+        {
+            autocorrelator.add(&x[0], n);
+            autocorrelator.finish(&fft[0]);
+        }, x);
+
+        // Stream the same signal in pieces of every size
+        unsigned long pos = 0;
+        while(pos < n)
+        {
+            unsigned long piece = std::min(n - pos,
+                    (unsigned long) rand() % 3000);
+            autocorrelator.add(&x[pos], piece);
+            pos += piece;
+        }
+        autocorrelator.finish(&streamed[0]);
+
+        double error = 0.0;
+        for(unsigned lag = 0; lag <= max_lag; lag++)
+        {
+            error = std::max(error, fabs(fft[lag] - direct[lag]) / direct[0]);
+            if(streamed[lag] != fft[lag])
+                failed = true;
+        }
+        if(error > 1e-9)
+            failed = true;
+
+        std::cout << "autocorrelate_direct_" << max_lag << "," << direct_ns <<
+            ",0" << std::endl;
+        std::cout << "autocorrelate_fft_" << max_lag << "," << fft_ns << "," <<
+            error << std::endl;
+    }
+
+    if(failed)
+    {
+        std::cerr << "The FFT autocorrelation does not match the direct sum"
+            << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
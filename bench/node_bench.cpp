@@ -0,0 +1,377 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "../src/clip_detector.h"
+#include "../src/gain_filter.h"
+#include "../src/lpc_analyzer.h"
+#include "../src/oscillator.h"
+#include "../src/ringbuffer.h"
+#include "../src/rt_log.h"
+#include "../src/scheduler.h"
+#include "../src/signal_graph.h"
+#include "../src/vocalist.h"
+
+using namespace ClickTrack;
+
+
+/* Microbenchmarks for each building block of the signal chain. Every result
+ * is printed as one CSV row: the cost in nanoseconds of one sample of one
+ * voice, and how many such voices one core could run in real time.
+ *
+ * Nodes are run through a SignalGraph into a sink that discards its input,
+ * as they are in the vocalist. The passthrough row measures that harness on
+ * its own, and is included in every node row.
+ */
+
+
+/* A consumer that throws away its input, so the benchmark measures only the
+ * cost of rendering
+ */
+class NullSink : public AudioConsumer
+{
+    public:
+        NullSink() : AudioConsumer(1) {}
+
+    private:
+        void process_inputs(std::vector<SAMPLE>& inputs, unsigned long t) {}
+        void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                unsigned long t) {}
+};
+
+
+/* A generator that outputs a constant, to feed filters under test
+ */
+class ConstantSource : public AudioGenerator
+{
+    public:
+        ConstantSource(SAMPLE in_value) : AudioGenerator(1), value(in_value) {}
+
+    private:
+        void generate_outputs(std::vector<SAMPLE>& outputs, unsigned long t)
+        {
+            outputs[0] = value;
+        }
+        void generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+                unsigned long t)
+        {
+            outputs[0].assign(BUFFER_SIZE, value);
+        }
+
+        SAMPLE value;
+};
+
+
+/* A target for the scheduler, which sums its payloads
+ */
+struct Accumulator
+{
+    static void add(Accumulator& caller, float value)
+    {
+        caller.total += value;
+    }
+
+    float total;
+};
+
+
+const unsigned long NUM_BLOCKS = 2000;
+const unsigned long NUM_SAMPLES = NUM_BLOCKS * BUFFER_SIZE;
+
+
+/* Prints one result row, given the elapsed time for a number of samples of
+ * a number of voices
+ */
+void report(const std::string& name, double ns, unsigned long samples,
+        unsigned voices = 1)
+{
+    double ns_per_sample = ns / samples / voices;
+    std::cout << name << "," << ns_per_sample << "," <<
+        1e9 / SAMPLE_RATE / ns_per_sample << std::endl;
+}
+
+
+/* Runs the graph feeding a sink for a number of blocks, and returns the
+ * elapsed time in nanoseconds
+ */
+double time_graph(Channel* output, unsigned long blocks)
+{
+    NullSink sink;
+    sink.set_input_channel(output);
+
+    SignalGraph graph;
+    graph.add_consumer(&sink);
+    graph.build();
+
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long i = 0; i < blocks; i++)
+        graph.run_block();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+
+void bench_ringbuffer()
+{
+    RingBuffer<SAMPLE> ring(4096);
+
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long t = 0; t < NUM_SAMPLES; t++)
+        ring.add(t);
+    auto end = std::chrono::steady_clock::now();
+    report("ringbuffer_add",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            NUM_SAMPLES);
+
+    // Add a block at a time, as channels do
+    std::vector<SAMPLE> block(BUFFER_SIZE, 0.5);
+    start = std::chrono::steady_clock::now();
+    for(unsigned long t = 0; t < NUM_SAMPLES; t += BUFFER_SIZE)
+        ring.add_block(&block[0], BUFFER_SIZE);
+    end = std::chrono::steady_clock::now();
+    report("ringbuffer_add_block",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            NUM_SAMPLES);
+
+    // Read back everything still in the ring, many times over
+    SAMPLE sum = 0.0;
+    unsigned long low = ring.get_lowest_timestamp();
+    unsigned long high = ring.get_highest_timestamp();
+    unsigned long reads = 0;
+    start = std::chrono::steady_clock::now();
+    while(reads < NUM_SAMPLES)
+    {
+        for(unsigned long t = low; t < high; t++)
+            sum += ring[t];
+        reads += high - low;
+    }
+    end = std::chrono::steady_clock::now();
+    report("ringbuffer_index",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            reads);
+
+    // And a block at a time
+    reads = 0;
+    start = std::chrono::steady_clock::now();
+    while(reads < NUM_SAMPLES)
+    {
+        for(unsigned long t = low; t + BUFFER_SIZE <= high; t += BUFFER_SIZE)
+        {
+            ring.get_range(block, t, t + BUFFER_SIZE);
+            sum += block[0];
+        }
+        reads += (high - low) / BUFFER_SIZE * BUFFER_SIZE;
+    }
+    end = std::chrono::steady_clock::now();
+    report("ringbuffer_get_range",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            reads);
+
+    // Keep the reads from being optimized away
+    if(sum == 0.0)
+        std::cerr << "ringbuffer_index read nothing" << std::endl;
+}
+
+
+void bench_channel()
+{
+    ConstantSource source(0.5);
+    Channel* channel = source.get_output_channel();
+
+    // Blocks are generated lazily as they are requested
+    SAMPLE sum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long t = 0; t < NUM_SAMPLES; t++)
+        sum += channel->get_sample(t);
+    auto end = std::chrono::steady_clock::now();
+    report("channel_get_sample",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            NUM_SAMPLES);
+
+    if(sum == 0.0)
+        std::cerr << "channel_get_sample read nothing" << std::endl;
+}
+
+
+void bench_passthrough()
+{
+    ConstantSource source(0.5);
+    report("passthrough", time_graph(source.get_output_channel(), NUM_BLOCKS),
+            NUM_SAMPLES);
+}
+
+
+void bench_oscillators()
+{
+    const char* names[] = { "sine", "saw", "square", "tri", "white_noise",
+        "blep_saw", "blep_square", "blep_tri", "pulse_train", "table_sine",
+        "table_saw", "table_square", "table_tri", "pink_noise",
+        "brown_noise" };
+    for(unsigned mode = Oscillator::Sine; mode <= Oscillator::BrownNoise;
+            mode++)
+    {
+        Oscillator osc((Oscillator::Mode) mode, 261.6);
+        report(std::string("oscillator_") + names[mode],
+                time_graph(osc.get_output_channel(), NUM_BLOCKS), NUM_SAMPLES);
+    }
+
+    // A vibrato, as the vocalist uses
+    ConstantSource lfo(0.5);
+    Oscillator vibrato(Oscillator::TableSaw, 261.6);
+    vibrato.set_lfo_input(lfo.get_output_channel());
+    vibrato.set_lfo_intensity(1.0);
+    report("oscillator_table_saw_lfo",
+            time_graph(vibrato.get_output_channel(), NUM_BLOCKS), NUM_SAMPLES);
+}
+
+
+void bench_gain_filter()
+{
+    ConstantSource source(0.5);
+    GainFilter gain(-6.0);
+    gain.set_input_channel(source.get_output_channel());
+    report("gain_filter", time_graph(gain.get_output_channel(), NUM_BLOCKS),
+            NUM_SAMPLES);
+
+    // Each graph needs its own sources, starting from time zero
+    ConstantSource tremolo_source(0.5), lfo(0.25);
+    GainFilter tremolo(-6.0);
+    tremolo.set_input_channel(tremolo_source.get_output_channel());
+    tremolo.set_lfo_input(lfo.get_output_channel());
+    tremolo.set_lfo_intensity(3.0);
+    report("gain_filter_lfo",
+            time_graph(tremolo.get_output_channel(), NUM_BLOCKS), NUM_SAMPLES);
+}
+
+
+void bench_clip_detector()
+{
+    // Stay below the threshold, so nothing is printed
+    ConstantSource source(0.5);
+    ClipDetector clip(1.0);
+    clip.set_input_channel(source.get_output_channel());
+    report("clip_detector", time_graph(clip.get_output_channel(), NUM_BLOCKS),
+            NUM_SAMPLES);
+}
+
+
+void bench_lpc_analyzer()
+{
+    // Analyze a voice-like signal at the vocalist's model order, as live
+    // input does. A hop's analysis lands within one block, so this must stay
+    // well below the block deadline.
+    Oscillator source(Oscillator::TableSaw, 261.6);
+    LpcAnalyzer analyzer(100);
+    analyzer.set_input_channel(source.get_output_channel());
+
+    SignalGraph graph;
+    graph.add_consumer(&analyzer);
+    graph.build();
+
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long block = 0; block < NUM_BLOCKS; block++)
+        graph.run_block();
+    auto end = std::chrono::steady_clock::now();
+    report("lpc_analyzer",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            NUM_SAMPLES);
+
+    if(!analyzer.update_model())
+        std::cerr << "lpc_analyzer fit no model" << std::endl;
+}
+
+
+void bench_scheduler()
+{
+    // Keep a block's worth of events pending, scattered over the block
+    Accumulator target = {0.0};
+    FunctionScheduler<Accumulator, float> scheduler(target);
+    srand(1);
+
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned long block = 0; block < NUM_BLOCKS; block++)
+    {
+        unsigned long t = block * BUFFER_SIZE;
+        for(unsigned i = 0; i < 32; i++)
+            scheduler.schedule(t + BUFFER_SIZE + rand() % BUFFER_SIZE,
+                    &Accumulator::add, 1.0);
+        for(unsigned j = 0; j < BUFFER_SIZE; j++)
+            scheduler.run(t + j);
+    }
+    auto end = std::chrono::steady_clock::now();
+    report("scheduler_run",
+            std::chrono::duration<double, std::nano>(end - start).count(),
+            NUM_SAMPLES);
+
+    if(scheduler.get_num_dropped() != 0)
+        std::cerr << "scheduler_run dropped events" << std::endl;
+}
+
+
+void bench_vocalist()
+{
+    // Each attack consonant is selected by a key in the second octave
+    const char* names[] = { "H", "T", "D", "F", "V", "L", "M", "N", "G", "K",
+        "B", "P", "Z", "S" };
+    const unsigned keys[] = { 36, 38, 40, 41, 43, 45, 47, 35, 33, 31, 29, 28,
+        26, 24 };
+
+    // Retrigger a chord of voices every tenth of a second, so that the
+    // attack is heard often
+    const unsigned num_voices = 8;
+    const unsigned long blocks = NUM_BLOCKS / 2;
+    const unsigned long retrigger = SAMPLE_RATE / 10 / BUFFER_SIZE;
+    for(unsigned i = 0; i < 14; i++)
+    {
+        Vocalist vocalist(num_voices);
+        vocalist.on_note_down(keys[i], 1.0);
+
+        NullSink sink;
+        sink.set_input_channel(vocalist.get_output_channel());
+        SignalGraph graph;
+        graph.add_consumer(&sink);
+        graph.build();
+
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned long block = 0; block < blocks; block++)
+        {
+            if(block % retrigger == 0)
+            {
+                unsigned long t = block * BUFFER_SIZE;
+                for(unsigned v = 0; v < num_voices; v++)
+                {
+                    if(block != 0)
+                        vocalist.on_note_up(48 + 2*v, 1.0, t);
+                    vocalist.on_note_down(48 + 2*v, 1.0, t);
+                }
+            }
+            graph.run_block();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        report(std::string("vocalist_attack_") + names[i],
+                std::chrono::duration<double, std::nano>(end - start).count(),
+                blocks * BUFFER_SIZE, num_voices);
+    }
+}
+
+
+int main()
+{
+    // The vocalist announces sound changes; keep them out of the results
+    RtLog::set_level(RtLog::WARNING);
+
+    std::cout << "benchmark,ns_per_sample,realtime_voices_per_core" << std::endl;
+
+    bench_ringbuffer();
+    bench_channel();
+    bench_passthrough();
+    bench_oscillators();
+    bench_gain_filter();
+    bench_clip_detector();
+    bench_lpc_analyzer();
+    bench_scheduler();
+    bench_vocalist();
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "../src/adder.h"
+#include "../src/signal_graph.h"
+#include "../src/vocalist.h"
+
+using namespace ClickTrack;
+
+
+/* A consumer that throws away its input, so the benchmark measures only the
+ * cost of rendering
+ */
+class NullSink : public AudioConsumer
+{
+    public:
+        NullSink() : AudioConsumer(1) {}
+
+    private:
+        void process_inputs(std::vector<SAMPLE>& inputs, unsigned long t) {}
+        void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                unsigned long t) {}
+};
+
+
+/* Renders a choir of vocalists mixed into one sink for the given number of
+ * seconds of audio, and returns the achieved real time factor
+ */
+double render_choir(unsigned num_voices, unsigned num_threads, float seconds)
+{
+    std::vector<Vocalist*> voices;
+    Adder mixer(num_voices);
+    for(unsigned i = 0; i < num_voices; i++)
+    {
+        voices.push_back(new Vocalist());
+        voices[i]->on_note_down(48 + i%17, 1.0);
+        mixer.set_input_channel(voices[i]->get_output_channel(), i);
+    }
+
+    NullSink sink;
+    sink.set_input_channel(mixer.get_output_channel());
+
+    SignalGraph graph(num_threads);
+    graph.add_consumer(&sink);
+    graph.build();
+
+    unsigned blocks = seconds * SAMPLE_RATE / BUFFER_SIZE;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < blocks; i++)
+        graph.run_block();
+    auto end = std::chrono::steady_clock::now();
+
+    for(unsigned i = 0; i < voices.size(); i++)
+        delete voices[i];
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    return (double) blocks * BUFFER_SIZE / SAMPLE_RATE / elapsed;
+}
+
+
+int main(int argc, char* argv[])
+{
+    using namespace std;
+
+    unsigned max_threads = thread::hardware_concurrency();
+    if(argc > 1)
+        max_threads = atoi(argv[1]);
+    if(max_threads == 0)
+        max_threads = 1;
+
+    // For each thread count, double the choir until it no longer keeps up
+    cout << "threads,voices,realtime_factor" << endl;
+    for(unsigned threads = 1; threads <= max_threads; threads++)
+    {
+        unsigned best = 0;
+        for(unsigned voices = 1; voices <= 1024; voices *= 2)
+        {
+            double factor = render_choir(voices, threads, 2.0);
+            cout << threads << "," << voices << "," << factor << endl;
+            if(factor < 1.0)
+                break;
+            best = voices;
+        }
+        cerr << threads << " threads: " << best << " realtime voices" << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "../src/spsc_queue.h"
+
+using namespace ClickTrack;
+
+
+/* Checks and measures the lock free queue that carries audio and events
+ * between threads.
+ *
+ * The stress check runs a producer and consumer thread through a small queue,
+ * so that it is constantly wrapping, full and empty. The producer sends
+ * a counting sequence one item or a batch at a time, and the consumer checks
+ * that it receives every number exactly once and in order. Both threads yield
+ * when they cannot make progress, so that the check also runs on one core.
+ *
+ * The throughput rows are printed as CSV, as the node benchmarks are.
+ */
+
+
+/* A cheap generator for batch sizes, so both threads vary them independently
+ */
+static unsigned next_random(unsigned& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+
+/* Sends count items through a queue of the given capacity, with batches of
+ * up to max_batch items. Returns the number of items received out of
+ * sequence, which should be zero.
+ */
+unsigned long stress(unsigned capacity, unsigned max_batch,
+        unsigned long count)
+{
+    SpscQueue<unsigned long> queue(capacity);
+    std::vector<unsigned long> batch(max_batch);
+
+    std::thread producer([&queue, max_batch, count]()
+    {
+        std::vector<unsigned long> out(max_batch);
+        unsigned state = 12345;
+        unsigned long next = 0;
+        while(next < count)
+        {
+            unsigned n = next_random(state) % max_batch + 1;
+            if(n > count - next)
+                n = count - next;
+
+            unsigned sent = 0;
+            if(n == 1)
+                sent = queue.push(next);
+            else
+            {
+                for(unsigned i = 0; i < n; i++)
+                    out[i] = next + i;
+                sent = queue.push(&out[0], n);
+            }
+
+            next += sent;
+            if(sent == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    unsigned state = 67890;
+    unsigned long expected = 0;
+    unsigned long errors = 0;
+    while(expected < count)
+    {
+        unsigned n = next_random(state) % max_batch + 1;
+        if(n == 1)
+        {
+            // Peek before popping, to check that front agrees with pop
+            const unsigned long* item = queue.front();
+            if(item == NULL)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            unsigned long peeked = *item;
+
+            unsigned long value = 0;
+            if(!queue.pop(value))
+            {
+                errors++;
+                continue;
+            }
+            if(value != peeked)
+                errors++;
+            if(value != expected)
+                errors++;
+            expected = value + 1;
+            continue;
+        }
+
+        unsigned got = queue.pop(&batch[0], n);
+        if(got == 0)
+            std::this_thread::yield();
+        for(unsigned i = 0; i < got; i++)
+        {
+            if(batch[i] != expected)
+                errors++;
+            expected = batch[i] + 1;
+        }
+    }
+
+    producer.join();
+    if(queue.size() != 0)
+        errors++;
+    return errors;
+}
+
+
+/* Moves count samples between two threads in batches of a given size, and
+ * prints the time taken per sample
+ */
+void throughput(const std::string& name, unsigned batch_size,
+        unsigned long count)
+{
+    SpscQueue<float> queue(4096);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&queue, batch_size, count]()
+    {
+        std::vector<float> out(batch_size, 0.5);
+        unsigned long sent = 0;
+        while(sent < count)
+        {
+            unsigned n = batch_size == 1 ? queue.push(out[0]) :
+                queue.push(&out[0], batch_size);
+            sent += n;
+            if(n == 0)
+                std::this_thread::yield();
+        }
+    });
+
+    std::vector<float> in(batch_size);
+    unsigned long received = 0;
+    while(received < count)
+    {
+        unsigned n = batch_size == 1 ? queue.pop(in[0]) :
+            queue.pop(&in[0], batch_size);
+        received += n;
+        if(n == 0)
+            std::this_thread::yield();
+    }
+    producer.join();
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << name << "," << ns / received << "," <<
+        received / ns * 1e3 << std::endl;
+}
+
+
+int main()
+{
+    // Batches both smaller and larger than the queue
+    unsigned long errors = stress(64, 16, 20000000) +
+        stress(16, 40, 5000000);
+    if(errors != 0)
+    {
+        std::cerr << "spsc_queue lost, duplicated or reordered " << errors <<
+            " items" << std::endl;
+        return 1;
+    }
+
+    std::cout << "benchmark,ns_per_item,million_items_per_second" << std::endl;
+    throughput("spsc_queue_push_pop", 1, 20000000);
+    throughput("spsc_queue_batch_16", 16, 100000000);
+    throughput("spsc_queue_batch_256", 256, 100000000);
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "../src/lattice_filter.h"
+#include "../src/signal_graph.h"
+#include "../src/vocalist.h"
+
+using namespace ClickTrack;
+
+
+/* A consumer that throws away its input, so the benchmark measures only the
+ * cost of rendering
+ */
+class NullSink : public AudioConsumer
+{
+    public:
+        NullSink() : AudioConsumer(1) {}
+
+    private:
+        void process_inputs(std::vector<SAMPLE>& inputs, unsigned long t) {}
+        void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                unsigned long t) {}
+};
+
+
+/* Renders a single polyphonic vocalist for the given number of seconds of
+ * audio, and returns the achieved real time factor. Silent voices cost
+ * nothing, so every voice in the pool is started directly. The singing range
+ * only has 17 notes, and a note already sounding would reuse its voice.
+ */
+double render_voices(unsigned num_voices, float seconds)
+{
+    Vocalist vocalist(num_voices);
+    for(unsigned v = 0; v < num_voices; v++)
+        vocalist.handle_note_down(v, midiNoteToFreq(48 + v%17), 0);
+
+    NullSink sink;
+    sink.set_input_channel(vocalist.get_output_channel());
+
+    SignalGraph graph;
+    graph.add_consumer(&sink);
+    graph.build();
+
+    unsigned blocks = seconds * SAMPLE_RATE / BUFFER_SIZE;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i = 0; i < blocks; i++)
+        graph.run_block();
+    auto end = std::chrono::steady_clock::now();
+
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    return (double) blocks * BUFFER_SIZE / SAMPLE_RATE / elapsed;
+}
+
+
+/* Takes the best of several runs, so that one unlucky run on a busy machine
+ * does not decide the result
+ */
+double best_render_voices(unsigned num_voices, float seconds, unsigned runs)
+{
+    double best = 0.0;
+    for(unsigned i = 0; i < runs; i++)
+        best = std::max(best, render_voices(num_voices, seconds));
+    return best;
+}
+
+
+int main()
+{
+    using namespace std;
+
+    // Double the pool until it no longer keeps up, then narrow down the
+    // largest pool that does
+    cout << "voices,realtime_factor" << endl;
+    unsigned best = 0;
+    unsigned worst = 0;
+    for(unsigned voices = 1; voices <= 4096; voices *= 2)
+    {
+        double factor = best_render_voices(voices, 1.0, 3);
+        cout << voices << "," << factor << endl;
+        if(factor < 1.0)
+        {
+            worst = voices;
+            break;
+        }
+        best = voices;
+    }
+
+    while(worst > best + 1)
+    {
+        unsigned voices = (best + worst) / 2;
+        double factor = best_render_voices(voices, 1.0, 3);
+        cout << voices << "," << factor << endl;
+        if(factor < 1.0)
+            worst = voices;
+        else
+            best = voices;
+    }
+
+    cerr << best << " realtime voices at " << SAMPLE_RATE << " Hz, "
+        << lattice_simd_lanes() << " lattice lanes" << endl;
+
+    return 0;
+}
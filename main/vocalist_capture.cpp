@@ -0,0 +1,59 @@
+#include <cstdlib>
+#include <iostream>
+#include "../src/microphone.h"
+#include "../src/signal_graph.h"
+#include "../src/wav_writer.h"
+
+using namespace ClickTrack;
+
+
+/* Records a phoneme for training from the default input device. Sing the
+ * phoneme as a chromatic scale of separate notes, as the other recordings
+ * are, for the given number of seconds. The recording is saved to
+ * RAW_DIR/NAME.wav, from where make train builds it into the model pack.
+ */
+int main(int argc, char* argv[])
+{
+    using namespace std;
+
+    if(argc < 2 || argc > 4)
+    {
+        cerr << "Usage: " << argv[0] << " NAME [SECONDS] [RAW_DIR]" << endl;
+        return 1;
+    }
+
+    string name = argv[1];
+    float seconds = argc > 2 ? atof(argv[2]) : 20;
+    string raw_dir = argc > 3 ? argv[3] : "wav/raw";
+    string path = raw_dir + "/" + name + ".wav";
+
+    try
+    {
+        unsigned long frames = seconds * SAMPLE_RATE;
+
+        Microphone mic;
+        WavWriter writer(path, 1, 16, frames);
+        writer.set_input_channel(mic.get_output_channel());
+
+        SignalGraph graph;
+        graph.add_consumer(&writer);
+        graph.build();
+
+        // The microphone blocks, so this runs as the audio is recorded
+        cout << "Recording " << name << " for " << seconds << " seconds..." <<
+            endl;
+        for(unsigned long t = 0; t < frames; t += BUFFER_SIZE)
+            graph.run_block();
+        writer.close();
+
+        cout << "Saved " << path << ". Run make train to rebuild the " <<
+            "models." << endl;
+    }
+    catch(std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
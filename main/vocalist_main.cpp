@@ -1,31 +1,86 @@
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include "../src/clip_detector.h"
+#include "../src/dsp_load.h"
+#include "../src/lpc_analyzer.h"
+#include "../src/microphone.h"
 #include "../src/midi_wrapper.h"
+#include "../src/rt_log.h"
+#include "../src/signal_graph.h"
 #include "../src/vocalist.h"
 #include "../src/speaker.h"
 
 
-int main()
+int main(int argc, char* argv[])
 {
     using namespace std;
 
+    // Sing monophonically unless asked for more voices, and render a couple
+    // of buffers ahead of the output. In live mode, sing through the vocal
+    // tract of the voice at the microphone.
+    unsigned num_voices = 1;
+    if(argc > 1)
+        num_voices = atoi(argv[1]);
+    unsigned render_ahead = 2;
+    if(argc > 2)
+        render_ahead = atoi(argv[2]);
+    bool live = argc > 3 && string(argv[3]) == "live";
+
+    // The audio thread logs, so start the logger ahead of it
+    RtLog::start();
+
     cout << "Initializing MIDI instrument" << endl;
-    Vocalist voice;
+    Vocalist voice(num_voices);
     MidiListener midi(&voice, 1);
 
     cout << "Creating signal chain" << endl;
     ClipDetector clip(1.0);
     clip.set_input_channel(voice.get_output_channel());
 
-    Speaker out;
+    Speaker out(1, true, render_ahead);
     out.set_input_channel(clip.get_output_channel());
 
-    cout << "Entering playback loop..." << endl << endl;
-    while(true)
+    // Let the MIDI listener timestamp events against the output
+    out.register_callback(&MidiListener::timing_callback, &midi);
+
+    SignalGraph graph;
+    graph.add_consumer(&out);
+
+    // The live input is owned here, like the rest of the signal chain
+    std::unique_ptr<Microphone> mic;
+    std::unique_ptr<LpcAnalyzer> analyzer;
+    if(live)
     {
-        out.consume();
+        cout << "Analyzing the microphone live" << endl;
+        mic.reset(new Microphone());
+        analyzer.reset(new LpcAnalyzer());
+        analyzer->set_input_channel(mic->get_output_channel());
+        voice.set_live_input(analyzer.get());
+        graph.add_consumer(analyzer.get());
     }
+    graph.build();
 
-    
-    return 0;
+#ifdef CLICKTRACK_PROFILE
+    // Report the load of each node alongside the underruns
+    DspLoadReporter load_reporter(5.0);
+#endif
+
+    // This thread renders, and the speaker plays from portaudio's callback,
+    // until the process is killed
+    cout << "Entering playback loop..." << endl << endl;
+    unsigned long reported_underruns = 0;
+    for(unsigned long block = 1; true; block++)
+    {
+        graph.run_block();
+
+        // Report any new underruns every few seconds
+        if(block % (5*SAMPLE_RATE/BUFFER_SIZE) == 0 &&
+                out.get_underruns() != reported_underruns)
+        {
+            reported_underruns = out.get_underruns();
+            cerr << reported_underruns << " underruns, output latency " <<
+                out.get_latency()*1000 << " ms" << endl;
+        }
+    }
 }
@@ -0,0 +1,92 @@
+#include <fstream>
+#include <iostream>
+#include "../src/model_pack.h"
+
+using namespace ClickTrack;
+
+
+/* Converts phoneme models saved by mtlb/saveModel.m into a single model pack.
+ * Each text model holds its name, gain, coefficient count and then the
+ * coefficients, one per line. Models saved by vocalist_train may go on with
+ * a count of trajectory frames, and then the coefficients of each frame in
+ * turn.
+ */
+int main(int argc, char* argv[])
+{
+    using namespace std;
+
+    if(argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " OUTPUT.pack MODEL.dat..." << endl;
+        return 1;
+    }
+
+    vector<string> names;
+    vector<float> gains;
+    vector< vector<float> > coeffs;
+    vector<ModelPack::Trajectory> trajectories;
+    for(int i = 2; i < argc; i++)
+    {
+        ifstream file(argv[i]);
+        string name;
+        float gain;
+        unsigned num_coeffs;
+        if(!(file >> name >> gain >> num_coeffs))
+        {
+            cerr << argv[i] << ": could not read the model header" << endl;
+            return 1;
+        }
+
+        vector<float> ks(num_coeffs);
+        for(unsigned j = 0; j < num_coeffs; j++)
+        {
+            if(!(file >> ks[j]))
+            {
+                cerr << argv[i] << ": expected " << num_coeffs <<
+                    " coefficients but found " << j << endl;
+                return 1;
+            }
+        }
+
+        // The trajectory is optional
+        unsigned num_frames = 0;
+        if(!(file >> num_frames))
+            num_frames = 0;
+
+        ModelPack::Trajectory frames(num_frames, vector<float>(num_coeffs));
+        for(unsigned f = 0; f < num_frames; f++)
+        {
+            for(unsigned j = 0; j < num_coeffs; j++)
+            {
+                if(!(file >> frames[f][j]))
+                {
+                    cerr << argv[i] << ": expected " << num_frames <<
+                        " trajectory frames but found " << f << endl;
+                    return 1;
+                }
+            }
+        }
+
+        names.push_back(name);
+        gains.push_back(gain);
+        coeffs.push_back(ks);
+        trajectories.push_back(frames);
+    }
+
+    try
+    {
+        ModelPack::write(argv[1], names, gains, coeffs, trajectories);
+
+        // Read the pack back to be sure it loads
+        ModelPack pack(argv[1]);
+        cout << "Wrote " << pack.get_num_phonemes() << " phonemes of " <<
+            pack.get_num_coeffs() << " coefficients to " << argv[1] << endl;
+    }
+    catch(ModelPackInvalid& e)
+    {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
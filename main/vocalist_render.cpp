@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include "../src/dsp_load.h"
+#include "../src/midi_file.h"
+#include "../src/midi_script.h"
+#include "../src/rt_log.h"
+#include "../src/signal_graph.h"
+#include "../src/vocalist.h"
+#include "../src/wav_writer.h"
+
+using namespace ClickTrack;
+
+
+/* Renders a vocalist offline to a WAV file, playing the events from a MIDI
+ * script or a Standard MIDI File at their exact sample times. Needs no audio
+ * or MIDI device, and runs as fast as the machine allows.
+ *
+ * Files ending in .mid or .midi are read as MIDI files, optionally keeping
+ * only one channel. Anything else is read as a script.
+ *
+ * Unless given a length in seconds, rendering stops a second after the last
+ * event.
+ */
+int main(int argc, char* argv[])
+{
+    using namespace std;
+
+    if(argc < 3)
+    {
+        cerr << "Usage: " << argv[0] <<
+            " SCRIPT|FILE.mid OUTPUT.wav [SECONDS] [VOICES] [BITS] "
+            "[CHANNEL]" << endl;
+        return 1;
+    }
+
+    float seconds = argc > 3 ? atof(argv[3]) : 0;
+    unsigned num_voices = argc > 4 ? atoi(argv[4]) : 1;
+    unsigned bits = argc > 5 ? atoi(argv[5]) : 16;
+    int channel = argc > 6 ? atoi(argv[6]) : -1;
+
+    try
+    {
+        string input = argv[1];
+        string extension = input.substr(input.find_last_of('.') + 1);
+        vector<MidiEvent> events;
+        if(extension == "mid" || extension == "midi")
+            events = read_midi_file(input, channel);
+        else
+            events = read_midi_script(input);
+
+        unsigned long frames = seconds * SAMPLE_RATE;
+        if(frames == 0)
+        {
+            frames = SAMPLE_RATE;
+            if(!events.empty())
+                frames += events.back().time;
+        }
+
+        Vocalist vocalist(num_voices);
+        WavWriter out(argv[2], 1, bits, frames);
+        out.set_input_channel(vocalist.get_output_channel());
+
+        SignalGraph graph;
+        graph.add_consumer(&out);
+        graph.build();
+
+        // Queue each block's events just before rendering it, so the
+        // instrument's queue only has to hold one block of events. A block
+        // with more events than that drops the rest, and says so
+        unsigned long blocks = (frames + BUFFER_SIZE - 1) / BUFFER_SIZE;
+        unsigned next_event = 0;
+        unsigned long dropped = 0;
+        auto start = chrono::steady_clock::now();
+        for(unsigned long block = 0; block < blocks; block++)
+        {
+            unsigned long end_time = (block + 1) * BUFFER_SIZE;
+            while(next_event < events.size() &&
+                    events[next_event].time < end_time)
+            {
+                if(!vocalist.queue_event(events[next_event]))
+                    dropped++;
+                next_event++;
+            }
+
+            graph.run_block();
+        }
+        auto end = chrono::steady_clock::now();
+        out.close();
+        RtLog::flush();
+
+        if(dropped > 0)
+            cerr << "Dropped " << dropped << " events that did not fit in "
+                "the instrument's queue" << endl;
+
+        double elapsed = chrono::duration<double>(end - start).count();
+        cout << "Rendered " << (double) frames / SAMPLE_RATE <<
+            " seconds to " << argv[2] << " in " << elapsed << " seconds (" <<
+            (double) frames / SAMPLE_RATE / elapsed << "x real time)" << endl;
+
+#ifdef CLICKTRACK_PROFILE
+        DspLoadReporter::report_total(cout);
+#endif
+    }
+    catch(std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include "../src/lpc.h"
+#include "../src/wav_reader.h"
+
+using namespace ClickTrack;
+
+
+/* One phoneme being trained
+ */
+struct Model
+{
+    std::string name;
+    std::string path;
+
+    float gain;
+    std::vector<float> ks;
+    std::vector< std::vector<float> > trajectory;
+
+    unsigned num_segments;
+    double seconds;
+    std::string error;
+};
+
+
+/* A model already saved in the data directory
+ */
+struct SavedModel
+{
+    std::string name;
+    std::string path;
+    float gain;
+};
+
+
+/* Lists the files in a directory with the given extension, in order.
+ * Returns false if the directory cannot be opened.
+ */
+bool list_files(const std::string& path, const std::string& extension,
+        std::vector<std::string>& files)
+{
+    DIR* dir = opendir(path.c_str());
+    if(dir == NULL)
+        return false;
+    while(dirent* entry = readdir(dir))
+    {
+        std::string file = entry->d_name;
+        if(file.size() > extension.size() && file.compare(
+                    file.size() - extension.size(), extension.size(),
+                    extension) == 0)
+            files.push_back(file);
+    }
+    closedir(dir);
+    sort(files.begin(), files.end());
+    return true;
+}
+
+
+/* Reads the name and gain of a saved model
+ */
+bool read_saved(SavedModel& model)
+{
+    std::ifstream file(model.path.c_str());
+    return (bool) (file >> model.name >> model.gain);
+}
+
+
+/* Rewrites the gain of a saved model, and leaves the rest of it be
+ */
+bool write_gain(const SavedModel& model, float gain)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(model.path.c_str());
+        std::string line;
+        while(std::getline(file, line))
+            lines.push_back(line);
+    }
+    if(lines.size() < 2)
+        return false;
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%f", gain);
+    lines[1] = buffer;
+
+    std::ofstream file(model.path.c_str(), std::ios::trunc);
+    for(unsigned i = 0; i < lines.size(); i++)
+        file << lines[i] << "\n";
+    return (bool) file;
+}
+
+
+/* Stops are a short burst into the vowel, which one set of coefficients
+ * cannot capture. Their models also hold a trajectory through the start of
+ * each note, of frames every 5ms over 20ms windows.
+ */
+const char* const stops[] = { "T", "D", "P", "B", "K", "G" };
+const unsigned trajectory_frames = 16;
+const float trajectory_hop_ms = 5;
+const float trajectory_window_ms = 20;
+
+
+/* Trains one model from its recording, as mtlb/trainModel.m does. Any error
+ * is stored in the model.
+ */
+void train(Model& model, unsigned poles)
+{
+    try
+    {
+        unsigned sample_rate;
+        std::vector<float> wav = read_wav(model.path, sample_rate);
+
+        // Model every sung note of the recording at once
+        std::vector< std::vector<float> > segments =
+            segment_recording(wav, 0.1, sample_rate);
+        std::vector<float> sung;
+        for(unsigned i = 0; i < segments.size(); i++)
+            sung.insert(sung.end(), segments[i].begin(), segments[i].end());
+        if(sung.size() <= poles)
+        {
+            model.error = "no notes were found in the recording";
+            return;
+        }
+
+        model.ks.resize(poles);
+        model.gain = compute_lpc(&sung[0], sung.size(), poles, &model.ks[0]);
+        model.num_segments = segments.size();
+        model.seconds = (double) sung.size() / sample_rate;
+
+        if(std::find(std::begin(stops), std::end(stops), model.name) ==
+                std::end(stops))
+            return;
+        fit_trajectory(wav, 0.1, sample_rate, poles, trajectory_frames,
+                trajectory_hop_ms * sample_rate / 1000,
+                trajectory_window_ms * sample_rate / 1000, model.trajectory);
+    }
+    catch(std::exception& e)
+    {
+        model.error = e.what();
+    }
+}
+
+
+/* Writes a model in the text format of mtlb/saveModel.m, followed by its
+ * trajectory if it has one
+ */
+bool save(const Model& model, const std::string& data_dir)
+{
+    std::string path = data_dir + "/" + model.name + ".dat";
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == NULL)
+        return false;
+
+    fprintf(file, "%s\n", model.name.c_str());
+    fprintf(file, "%f\n", model.gain);
+    fprintf(file, "%u\n", (unsigned) model.ks.size());
+    for(unsigned i = 0; i < model.ks.size(); i++)
+        fprintf(file, "%f\n", model.ks[i]);
+
+    if(!model.trajectory.empty())
+    {
+        fprintf(file, "%u\n", (unsigned) model.trajectory.size());
+        for(unsigned f = 0; f < model.trajectory.size(); f++)
+        {
+            for(unsigned i = 0; i < model.trajectory[f].size(); i++)
+                fprintf(file, "%f\n", model.trajectory[f][i]);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+
+/* Trains a phoneme model from every WAV recording in a directory, as
+ * mtlb/runTraining.m does, and saves them to the data directory. Each
+ * recording is named after its phoneme, and holds a sung chromatic scale.
+ *
+ * Recordings are trained in parallel, one per core. Once all are trained,
+ * their gains are normalized so the loudest of the whole model set is one,
+ * counting the models already in the data directory that were not
+ * retrained. Run vocalist_pack afterwards to pack the models for the
+ * synthesizer.
+ */
+int main(int argc, char* argv[])
+{
+    using namespace std;
+
+    if(argc > 4)
+    {
+        cerr << "Usage: " << argv[0] << " [POLES] [RAW_DIR] [DATA_DIR]" <<
+            endl;
+        return 1;
+    }
+
+    unsigned poles = argc > 1 ? atoi(argv[1]) : 100;
+    string raw_dir = argc > 2 ? argv[2] : "wav/raw";
+    string data_dir = argc > 3 ? argv[3] : "data";
+
+    // Find the recordings
+    vector<string> files;
+    if(!list_files(raw_dir, ".wav", files))
+    {
+        cerr << raw_dir << ": could not open the directory" << endl;
+        return 1;
+    }
+
+    if(files.empty())
+    {
+        cerr << raw_dir << ": no recordings found" << endl;
+        return 1;
+    }
+
+    vector<Model> models(files.size());
+    for(unsigned i = 0; i < files.size(); i++)
+    {
+        models[i].name = files[i].substr(0, files[i].size() - 4);
+        models[i].path = raw_dir + "/" + files[i];
+    }
+
+    // Each worker takes the next untrained recording until none are left
+    cout << "Training " << models.size() << " models of " << poles <<
+        " poles..." << endl;
+    auto start = chrono::steady_clock::now();
+
+    atomic<unsigned> next(0);
+    unsigned num_threads = max(1u, min(thread::hardware_concurrency(),
+                (unsigned) models.size()));
+    vector<thread> threads;
+    for(unsigned i = 0; i < num_threads; i++)
+    {
+        threads.push_back(thread([&models, &next, poles]()
+        {
+            for(unsigned m = next++; m < models.size(); m = next++)
+                train(models[m], poles);
+        }));
+    }
+    for(unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    auto end = chrono::steady_clock::now();
+
+    // Report, and give up before saving anything if a model failed
+    bool failed = false;
+    for(unsigned i = 0; i < models.size(); i++)
+    {
+        if(!models[i].error.empty())
+        {
+            cerr << models[i].path << ": " << models[i].error << endl;
+            failed = true;
+            continue;
+        }
+        cout << "    " << models[i].name << ": " << models[i].num_segments <<
+            " notes, " << models[i].seconds << " seconds" << endl;
+    }
+    if(failed)
+        return 1;
+
+    // Gains are normalized across the whole model set, as in
+    // mtlb/runTraining.m, so count the models already saved that are not
+    // being retrained. Their gains are normalized already, so they are put
+    // on the scale of the new ones through the loudest model that is both
+    // saved and retrained.
+    vector<string> dat_files;
+    list_files(data_dir, ".dat", dat_files);
+
+    vector<SavedModel> saved;
+    float scale = 0.0;
+    float overlap_gain = 0.0;
+    for(unsigned i = 0; i < dat_files.size(); i++)
+    {
+        SavedModel model;
+        model.path = data_dir + "/" + dat_files[i];
+        if(!read_saved(model))
+        {
+            cerr << model.path << ": could not read the model" << endl;
+            return 1;
+        }
+        unsigned m = 0;
+        while(m < models.size() && models[m].name != model.name)
+            m++;
+        if(m == models.size())
+            saved.push_back(model);
+        else if(model.gain > overlap_gain)
+        {
+            overlap_gain = model.gain;
+            scale = models[m].gain / model.gain;
+        }
+    }
+    if(!saved.empty() && scale == 0.0)
+    {
+        cerr << data_dir << ": none of the models here are retrained, so "
+            "the new gains cannot be normalized against them. Retrain the "
+            "whole set, or train into another directory." << endl;
+        return 1;
+    }
+
+    float max_gain = 0.0;
+    for(unsigned i = 0; i < saved.size(); i++)
+        max_gain = max(max_gain, saved[i].gain*scale);
+    for(unsigned i = 0; i < models.size(); i++)
+        max_gain = max(max_gain, models[i].gain);
+    for(unsigned i = 0; i < models.size(); i++)
+        models[i].gain /= max_gain;
+
+    for(unsigned i = 0; i < models.size(); i++)
+    {
+        if(!save(models[i], data_dir))
+        {
+            cerr << data_dir << "/" << models[i].name <<
+                ".dat: could not write the model" << endl;
+            return 1;
+        }
+    }
+
+    // Renormalize the saved models, should the loudest have changed
+    for(unsigned i = 0; i < saved.size(); i++)
+    {
+        float gain = saved[i].gain*scale / max_gain;
+        if(fabs(gain - saved[i].gain) < 5e-7)
+            continue;
+        if(!write_gain(saved[i], gain))
+        {
+            cerr << saved[i].path << ": could not rewrite the gain" << endl;
+            return 1;
+        }
+    }
+
+    double elapsed = chrono::duration<double>(end - start).count();
+    cout << "Trained in " << elapsed << " seconds on " << num_threads <<
+        " threads, and saved to " << data_dir << endl;
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include "adder.h"
+
+using namespace ClickTrack;
+
+
+Adder::Adder(unsigned num_inputs)
+    : AudioFilter(num_inputs, 1)
+{}
+
+
+void Adder::filter(std::vector<SAMPLE>& input,
+        std::vector<SAMPLE>& output, unsigned long t)
+{
+    SAMPLE sum = 0.0;
+    for(unsigned i = 0; i < input.size(); i++)
+        sum += input[i];
+    output[0] = sum;
+}
+
+
+void Adder::filter_block(std::vector< std::vector<SAMPLE> >& input,
+        std::vector< std::vector<SAMPLE> >& output, unsigned long t)
+{
+    std::vector<SAMPLE>& sum = output[0];
+    for(unsigned j = 0; j < BUFFER_SIZE; j++)
+        sum[j] = 0.0;
+
+    for(unsigned i = 0; i < input.size(); i++)
+    {
+        for(unsigned j = 0; j < BUFFER_SIZE; j++)
+            sum[j] += input[i][j];
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef ADDER_H
+#define ADDER_H
+
+#include "audio_generics.h"
+
+
+namespace ClickTrack
+{
+    /* The adder is a simple mixer. It sums all its input channels into a single
+     * output channel.
+     */
+    class Adder : public AudioFilter
+    {
+        public:
+            Adder(unsigned num_inputs);
+
+        private:
+            void filter(std::vector<SAMPLE>& input,
+                    std::vector<SAMPLE>& output, unsigned long t);
+            void filter_block(std::vector< std::vector<SAMPLE> >& input,
+                    std::vector< std::vector<SAMPLE> >& output,
+                    unsigned long t);
+    };
+}
+
+#endif
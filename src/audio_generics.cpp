@@ -1,5 +1,5 @@
-#include <iostream>
 #include "audio_generics.h"
+#include "rt_log.h"
 
 
 using namespace ClickTrack;
@@ -17,8 +17,8 @@ SAMPLE Channel::get_sample(unsigned long t)
     // If this block already fell out of the buffer, just return silence
     if(out.get_lowest_timestamp() > t)
     {
-        std::cerr << "Channel has requested a time older than is in "
-            << "its buffer." << std::endl;
+        RtLog::warning("Channel has requested a time older than is in "
+                "its buffer.");
         return 0.0;
     }
 
@@ -30,21 +30,48 @@ SAMPLE Channel::get_sample(unsigned long t)
 }
 
 
+void Channel::get_block(std::vector<SAMPLE>& buffer, unsigned long t)
+{
+    // If this block already fell out of the buffer, just return silence
+    if(out.get_lowest_timestamp() > t)
+    {
+        RtLog::warning("Channel has requested a time older than is in "
+                "its buffer.");
+        for(unsigned i = 0; i < BUFFER_SIZE; i++)
+            buffer[i] = 0.0;
+        return;
+    }
+
+    // Otherwise generate enough audio
+    while(out.get_highest_timestamp() < t + BUFFER_SIZE)
+        parent.generate();
+
+    out.get_range(buffer, t, t + BUFFER_SIZE);
+}
+
+
 void Channel::push_sample(SAMPLE s)
 {
     out.add(s);
 }
 
 
+void Channel::push_block(std::vector<SAMPLE>& block)
+{
+    out.add_block(&block[0], block.size());
+}
+
+
 
 
 AudioGenerator::AudioGenerator(unsigned in_num_output_channels)
-    : next_out_t(0), output_channels(), output_frame()
+    : next_out_t(0), output_channels(), output_frame(), output_block()
 {
     for(unsigned i = 0; i < in_num_output_channels; i++)
     {
         output_channels.push_back(Channel(*this));
         output_frame.push_back(0.0);
+        output_block.push_back(std::vector<SAMPLE>(BUFFER_SIZE));
     }
 }
 
@@ -65,12 +92,35 @@ Channel* AudioGenerator::get_output_channel(unsigned i)
 
 void AudioGenerator::generate()
 {
-    generate_outputs(output_frame, next_out_t);
-    next_out_t++;
+    CLICKTRACK_TIME_NODE(load, BUFFER_SIZE);
+
+    unsigned long t = next_out_t;
+    generate_block(output_block, t);
+    next_out_t = t + BUFFER_SIZE;
 
     //Write the outputs into the channel
     for(int i = 0; i < output_channels.size(); i++)
-        output_channels[i].push_sample(output_frame[i]);
+        output_channels[i].push_block(output_block[i]);
+}
+
+
+void AudioGenerator::generate_block(
+        std::vector< std::vector<SAMPLE> >& outputs, unsigned long t)
+{
+    for(unsigned i = 0; i < BUFFER_SIZE; i++)
+    {
+        // Keep the next time current for subclasses that rely on it
+        next_out_t = t + i;
+        generate_outputs(output_frame, t + i);
+
+        for(unsigned j = 0; j < outputs.size(); j++)
+            outputs[j][i] = output_frame[j];
+    }
+}
+
+
+void AudioGenerator::get_dependencies(std::vector<Channel*>& channels)
+{
 }
 
 
@@ -83,10 +133,14 @@ unsigned long AudioGenerator::get_next_time()
 
 
 AudioConsumer::AudioConsumer(unsigned in_num_input_channels)
-    : next_in_t(0), input_channels(in_num_input_channels, NULL), input_frame()
+    : next_in_t(0), input_channels(in_num_input_channels, NULL), input_frame(),
+      input_block()
 {
     for(unsigned i = 0; i < in_num_input_channels; i++)
+    {
         input_frame.push_back(0.0);
+        input_block.push_back(std::vector<SAMPLE>(BUFFER_SIZE));
+    }
 }
 
 
@@ -114,6 +168,14 @@ unsigned AudioConsumer::get_channel_index(Channel* channel)
 }
 
 
+Channel* AudioConsumer::get_input_channel(unsigned channel_i)
+{
+    if(channel_i >= input_channels.size())
+        throw ChannelOutOfRange();
+    return input_channels[channel_i];
+}
+
+
 unsigned AudioConsumer::get_num_input_channels()
 {
     return input_channels.size();
@@ -122,6 +184,8 @@ unsigned AudioConsumer::get_num_input_channels()
 
 void AudioConsumer::consume()
 {
+    CLICKTRACK_TIME_NODE(load, 1);
+
     // Read in each channel
     for(unsigned i = 0; i < input_channels.size(); i++)
     {
@@ -143,6 +207,47 @@ void AudioConsumer::consume()
 }
 
 
+void AudioConsumer::consume_block()
+{
+    CLICKTRACK_TIME_NODE(load, BUFFER_SIZE);
+
+    // Read in each channel
+    for(unsigned i = 0; i < input_channels.size(); i++)
+    {
+        // If there is no channel currently, read in silence
+        if(input_channels[i] == NULL)
+        {
+            for(unsigned j = 0; j < BUFFER_SIZE; j++)
+                input_block[i][j] = 0.0;
+        }
+        else
+        {
+            input_channels[i]->get_block(input_block[i], next_in_t);
+        }
+    }
+
+    // Process
+    unsigned long t = next_in_t;
+    process_block(input_block, t);
+    next_in_t = t + BUFFER_SIZE;
+}
+
+
+void AudioConsumer::process_block(std::vector< std::vector<SAMPLE> >& inputs,
+        unsigned long t)
+{
+    for(unsigned i = 0; i < BUFFER_SIZE; i++)
+    {
+        for(unsigned j = 0; j < inputs.size(); j++)
+            input_frame[j] = inputs[j][i];
+
+        // Keep the next time current for subclasses that rely on it
+        next_in_t = t + i;
+        process_inputs(input_frame, t + i);
+    }
+}
+
+
 unsigned long AudioConsumer::get_next_time()
 {
     return next_in_t;
@@ -154,21 +259,34 @@ unsigned long AudioConsumer::get_next_time()
 AudioFilter::AudioFilter(unsigned in_num_input_channels,
         unsigned in_num_output_channels)
     : AudioGenerator(in_num_output_channels),
-      AudioConsumer(in_num_input_channels), output_frame()
+      AudioConsumer(in_num_input_channels), input_frame(), output_frame(),
+      output_block()
 {
+    for(unsigned i = 0; i < in_num_input_channels; i++)
+    {
+        input_frame.push_back(0.0);
+    }
     for(unsigned i = 0; i < in_num_output_channels; i++)
     {
         output_frame.push_back(0.0);
+        output_block.push_back(std::vector<SAMPLE>(BUFFER_SIZE));
     }
 }
 
 
+void AudioFilter::get_dependencies(std::vector<Channel*>& channels)
+{
+    for(unsigned i = 0; i < get_num_input_channels(); i++)
+        channels.push_back(get_input_channel(i));
+}
+
+
 void AudioFilter::generate_outputs(std::vector<SAMPLE>& outputs, unsigned long t)
 {
     consume();
     
     // Copy our outputs to the final output buffer
-    for(unsigned i = 0; i <= outputs.size(); i++)
+    for(unsigned i = 0; i < outputs.size(); i++)
         outputs[i] = output_frame[i];
 }
 
@@ -179,6 +297,40 @@ void AudioFilter::process_inputs(std::vector<SAMPLE>& inputs, unsigned long t)
 }
 
 
+void AudioFilter::generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+        unsigned long t)
+{
+    consume_block();
+
+    // Copy our outputs to the final output buffer
+    for(unsigned i = 0; i < outputs.size(); i++)
+        outputs[i] = output_block[i];
+}
+
+
+void AudioFilter::process_block(std::vector< std::vector<SAMPLE> >& inputs,
+        unsigned long t)
+{
+    filter_block(inputs, output_block, t);
+}
+
+
+void AudioFilter::filter_block(std::vector< std::vector<SAMPLE> >& input,
+        std::vector< std::vector<SAMPLE> >& output, unsigned long t)
+{
+    for(unsigned i = 0; i < BUFFER_SIZE; i++)
+    {
+        for(unsigned j = 0; j < input.size(); j++)
+            input_frame[j] = input[j][i];
+
+        filter(input_frame, output_frame, t + i);
+
+        for(unsigned j = 0; j < output.size(); j++)
+            output[j][i] = output_frame[j];
+    }
+}
+
+
 
 
 FilterBank::FilterBank(unsigned in_num_output_channels,
@@ -2,15 +2,18 @@
 #define AUDIO_GENERICS_H
 
 #include <vector>
+#include "dsp_load.h"
 #include "portaudio_wrapper.h"
 #include "ringbuffer.h"
 
 
 namespace ClickTrack
 {
-    /* This determines the size of our internal ring buffers.
+    /* This determines the size of our internal ring buffers. Generators write
+     * a whole block at a time, so leave room for a reader that still lags one
+     * block behind.
      */
-    const unsigned DEFAULT_RINGBUFFER_SIZE = BUFFER_SIZE;
+    const unsigned DEFAULT_RINGBUFFER_SIZE = 2*BUFFER_SIZE;
 
 
     /* An output channel is the basic unit with which an object receives audio.
@@ -22,27 +25,37 @@ namespace ClickTrack
      */
     class AudioGenerator;
     class AudioConsumer;
+    class SignalGraph;
     class Channel
     {
         friend class AudioGenerator;
         friend class AudioConsumer;
         friend class AudioFilter;
+        friend class SignalGraph;
 
         public:
-            /* Fills an incoming buffer with one block worth of audio data
-             * beginning at the requested time.
+            /* Returns the sample at the requested time, generating more audio
+             * if it is not yet available.
              */
             SAMPLE get_sample(unsigned long t);
 
+            /* Fills an incoming buffer with one block worth of audio data
+             * beginning at the requested time. The buffer must hold
+             * BUFFER_SIZE samples.
+             */
+            void get_block(std::vector<SAMPLE>& buffer, unsigned long t);
+
         protected:
             /* A channel can only exist within an audio generator, so protect
              * the constructor
              */
             Channel(AudioGenerator& in_parent, unsigned long start_t=0);
 
-            /* Adds a sample to this Channel's internal buffer 
+            /* Adds a sample or a block of samples to this Channel's internal
+             * buffer 
              */
             void push_sample(SAMPLE s);
+            void push_block(std::vector<SAMPLE>& block);
 
             /* Internal state
              */
@@ -59,6 +72,7 @@ namespace ClickTrack
     class AudioGenerator
     {
         friend class Channel;
+        friend class SignalGraph;
 
         public:
             AudioGenerator(unsigned num_output_channels = 1);
@@ -78,13 +92,32 @@ namespace ClickTrack
             virtual void generate_outputs(std::vector<SAMPLE>& outputs, 
                     unsigned long t) = 0;
 
+            /* When called, fills each output vector with one block of
+             * BUFFER_SIZE samples beginning at time t.
+             *
+             * By default this calls generate_outputs once per sample.
+             * Subclasses may override it to process the whole block at once.
+             */
+            virtual void generate_block(
+                    std::vector< std::vector<SAMPLE> >& outputs,
+                    unsigned long t);
+
+            /* Appends every channel this generator reads from while generating
+             * its outputs, so that a SignalGraph can run their parents first.
+             * A null channel marks an input that is not connected.
+             *
+             * Generators with no inputs need not override this.
+             */
+            virtual void get_dependencies(std::vector<Channel*>& channels);
+
             /* Returns the next sample time
              */
             unsigned long get_next_time();
 
         private:
-            /* Writes outputs into the buffer. Calls tick to determine what to
-             * write out. Used by the output channel
+            /* Writes one block of outputs into the buffer. Calls
+             * generate_block to determine what to write out. Used by the
+             * output channel
              */
             void generate();
 
@@ -96,9 +129,16 @@ namespace ClickTrack
              */
             std::vector<Channel> output_channels;
 
-            /* Statically allocated frame for speed
+            /* Statically allocated frame and block for speed
              */
             std::vector<SAMPLE> output_frame;
+            std::vector< std::vector<SAMPLE> > output_block;
+
+#ifdef CLICKTRACK_PROFILE
+            /* Counters of the time spent generating
+             */
+            NodeLoad load;
+#endif
     };
 
 
@@ -113,6 +153,8 @@ namespace ClickTrack
      */
     class AudioConsumer
     {
+        friend class SignalGraph;
+
         public:
             AudioConsumer(unsigned num_input_channels = 1);
             virtual ~AudioConsumer() {}
@@ -126,12 +168,18 @@ namespace ClickTrack
             void remove_channel(unsigned channel_i);
 
             unsigned get_channel_index(Channel* channel);
+            Channel* get_input_channel(unsigned channel_i = 0);
 
             /* When called, reads in the next frame from the input channels
              * and calls the tick function.
              */
             void consume();
 
+            /* When called, reads in the next BUFFER_SIZE frames from the input
+             * channels and calls the block processing function.
+             */
+            void consume_block();
+
         protected:
             /* When called on input data, processes it. Must be overwritten in
              * subclass.
@@ -139,6 +187,16 @@ namespace ClickTrack
             virtual void process_inputs(std::vector<SAMPLE>& inputs, 
                     unsigned long t) = 0;
 
+            /* When called on one block of input data, processes it. Each input
+             * vector holds BUFFER_SIZE samples beginning at time t.
+             *
+             * By default this calls process_inputs once per sample. Subclasses
+             * may override it to process the whole block at once.
+             */
+            virtual void process_block(
+                    std::vector< std::vector<SAMPLE> >& inputs,
+                    unsigned long t);
+
             /* Returns the next sample time
              */
             unsigned long get_next_time();
@@ -152,9 +210,16 @@ namespace ClickTrack
              */
             std::vector<Channel*> input_channels;
 
-            /* statically allocated frame for speed
+            /* statically allocated frame and block for speed
              */
             std::vector<SAMPLE> input_frame;
+            std::vector< std::vector<SAMPLE> > input_block;
+
+#ifdef CLICKTRACK_PROFILE
+            /* Counters of the time spent consuming
+             */
+            NodeLoad load;
+#endif
     };
 
 
@@ -178,6 +243,21 @@ namespace ClickTrack
             virtual void filter(std::vector<SAMPLE>& input, 
                     std::vector<SAMPLE>& output, unsigned long t) = 0;
 
+            /* Given one block of input, generate a block of output data. Each
+             * vector holds BUFFER_SIZE samples beginning at time t.
+             *
+             * By default this calls filter once per sample. Subclasses may
+             * override it to process the whole block at once.
+             */
+            virtual void filter_block(
+                    std::vector< std::vector<SAMPLE> >& input,
+                    std::vector< std::vector<SAMPLE> >& output,
+                    unsigned long t);
+
+            /* A filter depends on each of its input channels
+             */
+            void get_dependencies(std::vector<Channel*>& channels);
+
             /* Gets the next sample time from the consumer
              */
             using AudioConsumer::get_next_time;
@@ -189,10 +269,19 @@ namespace ClickTrack
             void generate_outputs(std::vector<SAMPLE>& inputs, unsigned long t);
             void process_inputs(std::vector<SAMPLE>& outputs, unsigned long t);
 
-            /* Statically allocated frame for speed. Seperate from the
-             * generator's output to maintain clean interface
+            /* Override the block functions in the same way
              */
+            void generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+                    unsigned long t);
+            void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                    unsigned long t);
+
+            /* Statically allocated frames and block for speed. Seperate from
+             * the generator's output to maintain clean interface
+             */
+            std::vector<SAMPLE> input_frame;
             std::vector<SAMPLE> output_frame;
+            std::vector< std::vector<SAMPLE> > output_block;
     };
 
 
@@ -1,6 +1,6 @@
 #include <cmath>
-#include <iostream>
 #include "clip_detector.h"
+#include "rt_log.h"
 
 using namespace ClickTrack;
 
@@ -16,7 +16,7 @@ void ClipDetector::filter(std::vector<SAMPLE>& input,
     {
         if(fabs(input[i]) >= 1.0 && t > next_time)
         {
-            std::cout << "AUDIO CLIPPING DETECTED" << std::endl;
+            RtLog::info("AUDIO CLIPPING DETECTED");
             next_time = t + rate;
         }
 
@@ -24,3 +24,23 @@ void ClipDetector::filter(std::vector<SAMPLE>& input,
         output[i] = input[i];
     }
 }
+
+
+void ClipDetector::filter_block(std::vector< std::vector<SAMPLE> >& input,
+        std::vector< std::vector<SAMPLE> >& output, unsigned long t)
+{
+    for(int i = 0; i < input.size(); i++)
+    {
+        for(unsigned j = 0; j < BUFFER_SIZE; j++)
+        {
+            if(fabs(input[i][j]) >= 1.0 && t+j > next_time)
+            {
+                RtLog::info("AUDIO CLIPPING DETECTED");
+                next_time = t + j + rate;
+            }
+        }
+
+        // Copy inputs to outpts
+        output[i] = input[i];
+    }
+}
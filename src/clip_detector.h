@@ -7,7 +7,8 @@
 namespace ClickTrack
 {
     /* The clip detector monitors a channel for clipping, and will print to the
-     * console if it occurs. Rate limited, and acts as a pass through.
+     * console through RtLog if it occurs. Rate limited, and acts as a pass
+     * through.
      */
     class ClipDetector : public AudioFilter
     {
@@ -17,6 +18,9 @@ namespace ClickTrack
         private:
             void filter(std::vector<SAMPLE>& input,
                     std::vector<SAMPLE>& output, unsigned long t);
+            void filter_block(std::vector< std::vector<SAMPLE> >& input,
+                    std::vector< std::vector<SAMPLE> >& output,
+                    unsigned long t);
 
             /* Measures "time" in samples
              */
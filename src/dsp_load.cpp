@@ -0,0 +1,314 @@
+#ifdef CLICKTRACK_PROFILE
+
+#include <algorithm>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include "dsp_load.h"
+#include "portaudio_wrapper.h"
+
+using namespace ClickTrack;
+namespace chr = std::chrono;
+
+
+/* Every node's load is registered here, so the reporter can find it. Nodes
+ * are only created and destroyed outside the audio path, so a lock is fine.
+ */
+static std::mutex& registry_lock()
+{
+    static std::mutex lock;
+    return lock;
+}
+
+static std::vector<NodeLoad*>& registry()
+{
+    static std::vector<NodeLoad*> loads;
+    return loads;
+}
+
+static unsigned next_id = 0;
+
+
+NodeLoad::NodeLoad()
+    : id(0), type(NULL), total_ns(0), samples(0), calls(0)
+{
+    for(unsigned i = 0; i < num_buckets; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(registry_lock());
+    id = next_id++;
+    registry().push_back(this);
+}
+
+
+NodeLoad::~NodeLoad()
+{
+    std::lock_guard<std::mutex> guard(registry_lock());
+    std::vector<NodeLoad*>& loads = registry();
+    loads.erase(std::find(loads.begin(), loads.end(), this));
+}
+
+
+void NodeLoad::record(long long ns, unsigned in_samples,
+        const std::type_info& in_type)
+{
+    if(ns < 0)
+        ns = 0;
+
+    unsigned bucket = ns > 1 ? 63 - __builtin_clzll(ns) : 0;
+    if(bucket >= num_buckets)
+        bucket = num_buckets - 1;
+
+    type.store(&in_type, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+    samples.fetch_add(in_samples, std::memory_order_relaxed);
+    calls.fetch_add(1, std::memory_order_relaxed);
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+
+
+thread_local const void* NodeTimer::current_owner = NULL;
+thread_local long long NodeTimer::excluded_ns = 0;
+
+
+NodeTimer::NodeTimer(NodeLoad& in_load, const void* owner,
+        const std::type_info& in_type, unsigned in_samples)
+    : load(&in_load), type(in_type), samples(in_samples), start(),
+      parent_owner(current_owner), parent_excluded_ns(excluded_ns)
+{
+    // Nested within the same node, so the outer timer covers this
+    if(current_owner == owner)
+    {
+        load = NULL;
+        return;
+    }
+
+    current_owner = owner;
+    excluded_ns = 0;
+    start = chr::steady_clock::now();
+}
+
+
+NodeTimer::~NodeTimer()
+{
+    if(load == NULL)
+        return;
+
+    long long elapsed = chr::duration_cast<chr::nanoseconds>(
+            chr::steady_clock::now() - start).count();
+    load->record(elapsed - excluded_ns, samples, type);
+
+    // Our whole time is excluded from whoever pulled from us
+    current_owner = parent_owner;
+    excluded_ns = parent_excluded_ns + elapsed;
+}
+
+
+NodeTimer::Idle::Idle()
+    : start(chr::steady_clock::now())
+{}
+
+
+NodeTimer::Idle::~Idle()
+{
+    if(current_owner != NULL)
+        excluded_ns += chr::duration_cast<chr::nanoseconds>(
+                chr::steady_clock::now() - start).count();
+}
+
+
+
+
+DspLoadReporter::DspLoadReporter(float interval_seconds, bool in_json,
+        std::ostream& in_out)
+    : interval(interval_seconds), json(in_json), out(in_out),
+      stopping(false), lock(), wake(), thread()
+{
+    thread = std::thread(&DspLoadReporter::run, this);
+}
+
+
+DspLoadReporter::~DspLoadReporter()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+
+void DspLoadReporter::report_total(std::ostream& out, bool json)
+{
+    Snapshot now, before;
+    std::map<unsigned, std::string> names;
+    take_snapshot(now, names);
+    write_report(out, json, now, before, names);
+}
+
+
+void DspLoadReporter::run()
+{
+    Snapshot before;
+    std::map<unsigned, std::string> names;
+    take_snapshot(before, names);
+
+    std::unique_lock<std::mutex> guard(lock);
+    while(!stopping)
+    {
+        wake.wait_for(guard, chr::duration<float>(interval));
+        if(stopping)
+            break;
+
+        Snapshot now;
+        take_snapshot(now, names);
+        write_report(out, json, now, before, names);
+        before = now;
+    }
+}
+
+
+void DspLoadReporter::take_snapshot(Snapshot& snapshot,
+        std::map<unsigned, std::string>& names)
+{
+    std::lock_guard<std::mutex> guard(registry_lock());
+    std::vector<NodeLoad*>& loads = registry();
+    for(unsigned i = 0; i < loads.size(); i++)
+    {
+        NodeLoad* load = loads[i];
+        const std::type_info* type = load->type.load(
+                std::memory_order_relaxed);
+        if(type == NULL)
+            continue; // never run
+
+        Counters& counters = snapshot[load->id];
+        counters.total_ns = load->total_ns.load(std::memory_order_relaxed);
+        counters.samples = load->samples.load(std::memory_order_relaxed);
+        counters.calls = load->calls.load(std::memory_order_relaxed);
+        for(unsigned b = 0; b < NodeLoad::num_buckets; b++)
+            counters.buckets[b] = load->buckets[b].load(
+                    std::memory_order_relaxed);
+
+        // Name each node by its type, without our namespace
+        if(names.count(load->id) == 0)
+        {
+            int status;
+            char* demangled = abi::__cxa_demangle(type->name(), NULL, NULL,
+                    &status);
+            std::string name = status == 0 ? demangled : type->name();
+            free(demangled);
+            if(name.compare(0, 12, "ClickTrack::") == 0)
+                name.erase(0, 12);
+            names[load->id] = name;
+        }
+    }
+}
+
+
+/* One node's line in a report
+ */
+struct NodeRow
+{
+    std::string name;
+    unsigned id;
+    double load;
+    unsigned long long calls;
+    unsigned long long p99_ns;
+    unsigned long long max_ns;
+};
+
+static bool heavier(const NodeRow& a, const NodeRow& b)
+{
+    return a.load > b.load;
+}
+
+
+void DspLoadReporter::write_report(std::ostream& out, bool json,
+        const Snapshot& now, const Snapshot& before,
+        const std::map<unsigned, std::string>& names)
+{
+    // Every node runs over the same audio, so the node that handled the most
+    // samples tells how long the audio lasted
+    unsigned long long audio_samples = 0;
+    for(Snapshot::const_iterator it = now.begin(); it != now.end(); ++it)
+    {
+        Snapshot::const_iterator old = before.find(it->first);
+        unsigned long long samples = it->second.samples -
+            (old == before.end() ? 0 : old->second.samples);
+        audio_samples = std::max(audio_samples, samples);
+    }
+    double audio_ns = 1e9 * audio_samples / SAMPLE_RATE;
+
+    std::vector<NodeRow> rows;
+    double total = 0.0;
+    for(Snapshot::const_iterator it = now.begin(); it != now.end(); ++it)
+    {
+        Counters delta = it->second;
+        Snapshot::const_iterator old = before.find(it->first);
+        if(old != before.end())
+        {
+            delta.total_ns -= old->second.total_ns;
+            delta.calls -= old->second.calls;
+            for(unsigned b = 0; b < NodeLoad::num_buckets; b++)
+                delta.buckets[b] -= old->second.buckets[b];
+        }
+        if(delta.calls == 0)
+            continue;
+
+        // Percentiles are given as the top of their histogram bucket
+        NodeRow row = { names.find(it->first)->second, it->first,
+            delta.total_ns / audio_ns, delta.calls, 0, 0 };
+        unsigned long long seen = 0;
+        for(unsigned b = 0; b < NodeLoad::num_buckets; b++)
+        {
+            if(delta.buckets[b] == 0)
+                continue;
+            seen += delta.buckets[b];
+            if(row.p99_ns == 0 && seen >= 0.99 * delta.calls)
+                row.p99_ns = 2ULL << b;
+            row.max_ns = 2ULL << b;
+        }
+
+        rows.push_back(row);
+        total += row.load;
+    }
+    std::sort(rows.begin(), rows.end(), heavier);
+
+    double deadline_ms = 1000.0 * BUFFER_SIZE / SAMPLE_RATE;
+    if(json)
+    {
+        out << "{\"deadline_ms\":" << deadline_ms << ",\"audio_seconds\":" <<
+            audio_ns / 1e9 << ",\"total_load\":" << total << ",\"nodes\":[";
+        for(unsigned i = 0; i < rows.size(); i++)
+        {
+            out << (i == 0 ? "" : ",") << "{\"name\":\"" << rows[i].name <<
+                "\",\"id\":" << rows[i].id << ",\"load\":" << rows[i].load <<
+                ",\"calls\":" << rows[i].calls << ",\"p99_ns\":" <<
+                rows[i].p99_ns << ",\"max_ns\":" << rows[i].max_ns << "}";
+        }
+        out << "]}" << std::endl;
+        return;
+    }
+
+    out << std::fixed << std::setprecision(1) << "DSP load " <<
+        100*total << "% over " << audio_ns / 1e9 << " s of audio, " <<
+        std::setprecision(3) << deadline_ms << " ms per block" << std::endl;
+    for(unsigned i = 0; i < rows.size(); i++)
+    {
+        std::ostringstream label;
+        label << rows[i].name << "#" << rows[i].id;
+        out << "    " << std::left << std::setw(24) << label.str() <<
+            std::right << std::setprecision(1) << std::setw(6) <<
+            100*rows[i].load << "%   p99 < " << std::setprecision(3) <<
+            rows[i].p99_ns / 1e6 << " ms   max < " << rows[i].max_ns / 1e6 <<
+            " ms" << std::endl;
+    }
+    out << std::defaultfloat;
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef DSP_LOAD_H
+#define DSP_LOAD_H
+
+/* Optional instrumentation of the DSP load of each node in the signal chain.
+ * It is only compiled in when CLICKTRACK_PROFILE is defined, eg by building
+ * with make PROFILE=1. Otherwise the macros below expand to nothing, and
+ * nothing is measured.
+ *
+ * Each generator and consumer keeps a NodeLoad. Every block it generates or
+ * consumes is timed with the steady clock, excluding any time spent in other
+ * nodes it pulls from, and is added to lock free counters and a histogram of
+ * the time per call. A DspLoadReporter thread then reads these periodically,
+ * and prints the load of each node and of the whole chain as a percentage of
+ * the time the audio lasts. Nothing is printed from the audio thread.
+ */
+#ifdef CLICKTRACK_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+
+
+namespace ClickTrack
+{
+    /* The load counters for one node. They are written by whichever thread
+     * runs the node, and read by the reporter.
+     */
+    class NodeLoad
+    {
+        friend class DspLoadReporter;
+
+        public:
+            NodeLoad();
+            ~NodeLoad();
+
+            /* Adds one call that took the given time to process samples
+             */
+            void record(long long ns, unsigned samples,
+                    const std::type_info& type);
+
+            /* Calls are binned by the power of two nanoseconds they took
+             */
+            static const unsigned num_buckets = 32;
+
+        private:
+            unsigned id;
+            std::atomic<const std::type_info*> type;
+            std::atomic<unsigned long long> total_ns;
+            std::atomic<unsigned long long> samples;
+            std::atomic<unsigned long long> calls;
+            std::atomic<unsigned long long> buckets[num_buckets];
+    };
+
+
+    /* Times a node for as long as it is in scope, and records the time into
+     * its load on destruction. Time spent in any node timed within that scope
+     * is not counted, so each node is charged only for its own work.
+     *
+     * A filter is both a generator and a consumer. When it consumes from
+     * within its own generate, only the outer call is recorded.
+     */
+    class NodeTimer
+    {
+        public:
+            NodeTimer(NodeLoad& load, const void* owner,
+                    const std::type_info& type, unsigned samples);
+            ~NodeTimer();
+
+            /* Excludes time spent waiting, eg for room in an output stream,
+             * from the node currently being timed
+             */
+            class Idle
+            {
+                public:
+                    Idle();
+                    ~Idle();
+
+                private:
+                    std::chrono::steady_clock::time_point start;
+            };
+
+        private:
+            NodeLoad* load;
+            const std::type_info& type;
+            const unsigned samples;
+            std::chrono::steady_clock::time_point start;
+
+            /* The enclosing timer's state, restored on destruction
+             */
+            const void* parent_owner;
+            long long parent_excluded_ns;
+
+            /* The node being timed on this thread, and time to exclude from
+             * it
+             */
+            static thread_local const void* current_owner;
+            static thread_local long long excluded_ns;
+    };
+
+
+    /* Reports the load of every node periodically from a background thread,
+     * for as long as it exists. Each report covers the time since the last.
+     * Reports are either readable text, or one JSON object per line.
+     */
+    class DspLoadReporter
+    {
+        public:
+            DspLoadReporter(float interval_seconds, bool json = false,
+                    std::ostream& out = std::cerr);
+            ~DspLoadReporter();
+
+            /* Writes a single report of the load since the program began
+             */
+            static void report_total(std::ostream& out, bool json = false);
+
+        private:
+            /* A snapshot of the counters of one node
+             */
+            struct Counters
+            {
+                unsigned long long total_ns;
+                unsigned long long samples;
+                unsigned long long calls;
+                unsigned long long buckets[NodeLoad::num_buckets];
+            };
+            typedef std::map<unsigned, Counters> Snapshot;
+
+            void run();
+
+            /* Reads every node's counters, and writes the difference from
+             * a previous snapshot
+             */
+            static void take_snapshot(Snapshot& snapshot,
+                    std::map<unsigned, std::string>& names);
+            static void write_report(std::ostream& out, bool json,
+                    const Snapshot& now, const Snapshot& before,
+                    const std::map<unsigned, std::string>& names);
+
+            const float interval;
+            const bool json;
+            std::ostream& out;
+
+            bool stopping;
+            std::mutex lock;
+            std::condition_variable wake;
+            std::thread thread;
+    };
+}
+
+#define CLICKTRACK_TIME_NODE(load, samples) \
+    NodeTimer node_timer(load, dynamic_cast<const void*>(this), \
+            typeid(*this), samples)
+#define CLICKTRACK_IDLE_SCOPE() NodeTimer::Idle node_idle
+
+#else
+
+#define CLICKTRACK_TIME_NODE(load, samples)
+#define CLICKTRACK_IDLE_SCOPE()
+
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <cstring>
+#include "portaudio_wrapper.h"
+
+
+namespace ClickTrack
+{
+    /* Fast approximations of the exponentials used for modulation, in place
+     * of pow on the audio path.
+     */
+
+    /* Computes 2^x. The integer part of x is placed straight into the
+     * exponent of a float, and 2^f for the fraction f in [0, 1) comes from a
+     * fourth order polynomial fitted to minimize relative error.
+     *
+     * For x in [-126, 126] the relative error is below 6e-6, or 3.1e-6 when
+     * |x| < 3. That is at most 0.0001 of a semitone, or 0.00005 dB. Outside
+     * that range x is clamped.
+     */
+    inline float fast_exp2(float x)
+    {
+        if(x < -126.0f) x = -126.0f;
+        if(x > 126.0f) x = 126.0f;
+
+        int i = (int) x;
+        if(x < i)
+            i--;
+        float f = x - i;
+
+        float p = 1.0f + f*(0.69304484f + f*(0.241280227f +
+                    f*(0.0522424428f + f*0.0134266981f)));
+
+        int bits = (i + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(float));
+        return p * scale;
+    }
+
+    /* Computes 10^x, with the same relative error as fast_exp2
+     */
+    inline float fast_pow10(float x)
+    {
+        return fast_exp2(x * 3.32192809f);
+    }
+
+    /* Converts decibels to an amplitude gain, with the same relative error as
+     * fast_exp2
+     */
+    inline float fast_db_to_gain(float db)
+    {
+        return fast_exp2(db * 0.166096405f);
+    }
+
+    /* Fills output with 2^(input*scale) for n samples of a modulation
+     * signal. The exponential is only computed every CONTROL_INTERVAL samples
+     * and on the last sample, and is interpolated linearly in between. For
+     * a slow LFO the interpolation adds no more error than fast_exp2. The
+     * input and output may be the same array.
+     */
+    inline void control_rate_exp2(const SAMPLE* input, float scale,
+            float* output, unsigned n)
+    {
+        if(n == 0)
+            return;
+
+        float from = fast_exp2(input[0] * scale);
+        for(unsigned start = 0; start < n; start += CONTROL_INTERVAL)
+        {
+            // The last piece ends on the last sample instead
+            unsigned end = start + CONTROL_INTERVAL;
+            unsigned target = end < n ? end : n-1;
+            float to = fast_exp2(input[target] * scale);
+
+            float step = target > start ? (to - from) / (target - start) : 0;
+            if(end > n)
+                end = n;
+            for(unsigned i = start; i < end; i++)
+                output[i] = from + step*(i - start);
+
+            from = to;
+        }
+    }
+}
+
+#endif
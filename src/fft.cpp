@@ -0,0 +1,126 @@
+#include <cmath>
+#include "fft.h"
+
+using namespace ClickTrack;
+
+
+/* Multiplies complex numbers directly. The standard operator also handles
+ * infinities and NaNs, which makes it many times slower.
+ */
+static inline std::complex<double> multiply(const std::complex<double>& a,
+        const std::complex<double>& b)
+{
+    return std::complex<double>(a.real()*b.real() - a.imag()*b.imag(),
+            a.real()*b.imag() + a.imag()*b.real());
+}
+
+
+RealFft::RealFft(unsigned in_size)
+    : size(in_size), bit_reversed(in_size/2), twiddles(in_size/4),
+      rotations(in_size/2 + 1), scratch(in_size/2)
+{
+    if(size < 4 || (size & (size - 1)) != 0)
+        throw FftSizeInvalid();
+
+    // The order the complex FFT reads its inputs in
+    const unsigned half = size/2;
+    unsigned bits = 0;
+    while((1u << bits) < half)
+        bits++;
+    for(unsigned i = 0; i < half; i++)
+    {
+        unsigned reversed = 0;
+        for(unsigned b = 0; b < bits; b++)
+        {
+            if(i & (1u << b))
+                reversed |= 1u << (bits - 1 - b);
+        }
+        bit_reversed[i] = reversed;
+    }
+
+    for(unsigned k = 0; k < half/2; k++)
+        twiddles[k] = std::polar(1.0, -2.0*M_PI*k / half);
+    for(unsigned k = 0; k <= half; k++)
+        rotations[k] = std::polar(1.0, -2.0*M_PI*k / size);
+}
+
+
+unsigned RealFft::get_size()
+{
+    return size;
+}
+
+
+void RealFft::forward(const double* in, std::complex<double>* out)
+{
+    // Pack the even and odd samples together, in bit reversed order
+    const unsigned half = size/2;
+    for(unsigned i = 0; i < half; i++)
+        scratch[bit_reversed[i]] = std::complex<double>(in[2*i], in[2*i + 1]);
+    transform(&scratch[0], false);
+
+    // Separate the spectra of the even and odd samples, and combine them
+    const std::complex<double> i_unit(0.0, 1.0);
+    for(unsigned k = 0; k <= half; k++)
+    {
+        std::complex<double> z = scratch[k % half];
+        std::complex<double> z_mirror = std::conj(scratch[(half - k) % half]);
+        std::complex<double> even = 0.5 * (z + z_mirror);
+        std::complex<double> odd = -0.5 * i_unit * (z - z_mirror);
+        out[k] = even + multiply(rotations[k], odd);
+    }
+}
+
+
+void RealFft::inverse(const std::complex<double>* in, double* out)
+{
+    // Recover the spectra of the even and odd samples, and pack them
+    const unsigned half = size/2;
+    const std::complex<double> i_unit(0.0, 1.0);
+    for(unsigned k = 0; k < half; k++)
+    {
+        std::complex<double> x_mirror = std::conj(in[half - k]);
+        std::complex<double> even = 0.5 * (in[k] + x_mirror);
+        std::complex<double> odd = multiply(0.5 * (in[k] - x_mirror),
+                std::conj(rotations[k]));
+        scratch[bit_reversed[k]] = even + i_unit * odd;
+    }
+    transform(&scratch[0], true);
+
+    const double scale = 1.0 / half;
+    for(unsigned i = 0; i < half; i++)
+    {
+        out[2*i] = scratch[i].real() * scale;
+        out[2*i + 1] = scratch[i].imag() * scale;
+    }
+}
+
+
+void RealFft::transform(std::complex<double>* data, bool inverse)
+{
+    // Combine pairs of ever larger transforms. The data starts in bit
+    // reversed order. Complex values are stored as pairs of doubles.
+    const unsigned half = size/2;
+    double* d = reinterpret_cast<double*>(data);
+    for(unsigned span = 1; span < half; span *= 2)
+    {
+        const unsigned stride = half / (2*span);
+        for(unsigned j = 0; j < span; j++)
+        {
+            const double w_re = twiddles[j*stride].real();
+            const double w_im = inverse ? -twiddles[j*stride].imag() :
+                twiddles[j*stride].imag();
+            for(unsigned start = 0; start < half; start += 2*span)
+            {
+                double* a = d + 2*(start + j);
+                double* b = d + 2*(start + j + span);
+                double b_re = w_re*b[0] - w_im*b[1];
+                double b_im = w_re*b[1] + w_im*b[0];
+                b[0] = a[0] - b_re;
+                b[1] = a[1] - b_im;
+                a[0] += b_re;
+                a[1] += b_im;
+            }
+        }
+    }
+}
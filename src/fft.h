@@ -0,0 +1,64 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <exception>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* A fast Fourier transform of real signals, of a fixed power of two size.
+     * It is self contained, and works in double precision.
+     *
+     * A real signal of size N is transformed as a complex signal of size N/2,
+     * holding the even samples in its real part and the odd samples in its
+     * imaginary part, by an iterative radix-2 FFT. The two halves are then
+     * separated into the N/2+1 bins of the real spectrum. The twiddle factors
+     * and bit reversal order are computed once, on construction.
+     */
+    class RealFft
+    {
+        public:
+            /* Throws FftSizeInvalid unless size is a power of two, of at
+             * least 4
+             */
+            RealFft(unsigned size);
+
+            unsigned get_size();
+
+            /* Transforms size real samples into size/2+1 bins
+             */
+            void forward(const double* in, std::complex<double>* out);
+
+            /* Transforms size/2+1 bins back into size real samples, scaled
+             * so that it inverts forward exactly
+             */
+            void inverse(const std::complex<double>* in, double* out);
+
+        private:
+            /* Runs the complex FFT of size/2 in place. The inverse transform
+             * is unscaled.
+             */
+            void transform(std::complex<double>* data, bool inverse);
+
+            const unsigned size;
+            std::vector<unsigned> bit_reversed;
+            std::vector< std::complex<double> > twiddles; // of the half size
+            std::vector< std::complex<double> > rotations; // of the full size
+            std::vector< std::complex<double> > scratch;
+    };
+
+
+    /* Exception thrown when an FFT is constructed with an invalid size
+     */
+    class FftSizeInvalid: public std::exception
+    {
+        virtual const char* what() const throw()
+        {
+            return "The FFT size must be a power of two, of at least 4.";
+        }
+    };
+}
+
+#endif
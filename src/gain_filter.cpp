@@ -1,4 +1,5 @@
 #include <cmath>
+#include "fast_math.h"
 #include "gain_filter.h"
 
 using namespace ClickTrack;
@@ -6,7 +7,7 @@ using namespace ClickTrack;
 
 GainFilter::GainFilter(float in_gain, unsigned num_channels)
     : AudioFilter(num_channels, num_channels), gain(pow(10, in_gain/10)),
-      lfo(nullptr), lfo_intensity(0.0)
+      lfo(nullptr), lfo_intensity(0.0), lfo_block(BUFFER_SIZE)
 {}
 
 void GainFilter::set_gain(float in_gain)
@@ -24,16 +25,48 @@ void GainFilter::set_lfo_intensity(float db)
     lfo_intensity = db;
 }
 
+void GainFilter::get_dependencies(std::vector<Channel*>& channels)
+{
+    AudioFilter::get_dependencies(channels);
+    if(lfo != nullptr)
+        channels.push_back(lfo);
+}
+
 void GainFilter::filter(std::vector<SAMPLE>& input,
         std::vector<SAMPLE>& output, unsigned long t)
 {
+    // Use the LFO if set
+    float m = gain;
+    if(lfo != nullptr)
+        m *= fast_pow10(lfo->get_sample(t) * lfo_intensity/10);
+
     for(int i = 0; i < input.size(); i++)
+        output[i] = m*input[i];
+}
+
+void GainFilter::filter_block(std::vector< std::vector<SAMPLE> >& input,
+        std::vector< std::vector<SAMPLE> >& output, unsigned long t)
+{
+    // Without an LFO the gain is constant
+    if(lfo == nullptr)
     {
-        // Use the LFO if set
-        float m = 1.0;
-        if(lfo != nullptr)
-            m *= pow(10, lfo->get_sample(t) * lfo_intensity/10);
+        for(int i = 0; i < input.size(); i++)
+        {
+            for(unsigned j = 0; j < BUFFER_SIZE; j++)
+                output[i][j] = gain*input[i][j];
+        }
+        return;
+    }
+
+    // Otherwise turn the whole LFO block into gains at control rate, as
+    // 10^(x/10) = 2^(x*log2(10)/10)
+    lfo->get_block(lfo_block, t);
+    control_rate_exp2(&lfo_block[0], lfo_intensity * 0.332192809f,
+            &lfo_block[0], BUFFER_SIZE);
 
-        output[i] = gain*m*input[i];
+    for(int i = 0; i < input.size(); i++)
+    {
+        for(unsigned j = 0; j < BUFFER_SIZE; j++)
+            output[i][j] = gain*lfo_block[j]*input[i][j];
     }
 }
@@ -28,11 +28,19 @@ namespace ClickTrack
         private:
             void filter(std::vector<SAMPLE>& input,
                     std::vector<SAMPLE>& output, unsigned long t);
+            void filter_block(std::vector< std::vector<SAMPLE> >& input,
+                    std::vector< std::vector<SAMPLE> >& output,
+                    unsigned long t);
+
+            /* The gain filter also depends on its LFO, if one is set
+             */
+            void get_dependencies(std::vector<Channel*>& channels);
 
             float gain;
 
             Channel* lfo;
             float lfo_intensity;
+            std::vector<SAMPLE> lfo_block;
     };
 }
 
@@ -10,9 +10,82 @@ float ClickTrack::midiNoteToFreq(unsigned note)
 }
 
 
+bool ClickTrack::parse_midi_message(const unsigned char* message,
+        unsigned size, MidiEvent& event)
+{
+    if(size == 0)
+        return false;
+
+    // Case on message type
+    unsigned char type = message[0] >> 4;
+    switch(type)
+    {
+        case 0x9: // Note down
+        case 0x8: // Note up
+        {
+            if(size < 3)
+                return false;
+
+            bool down = type == 0x9 && message[2] != 0;
+            event.type = down ? MidiEvent::NOTE_DOWN : MidiEvent::NOTE_UP;
+            event.note = message[1];
+            event.value = double(message[2])/100;
+            return true;
+        }
+
+        case 0xB: // Control message
+        {
+            if(size < 3)
+                return false;
+
+            switch(message[1])
+            {
+                case 0x01: // modulation wheel
+                    event.type = MidiEvent::MODULATION_WHEEL;
+                    event.value = (float)message[2] / 127;
+                    return true;
+
+                case 0x40: // sustain pedal
+                    if(message[2] < 63)
+                        event.type = MidiEvent::SUSTAIN_UP;
+                    else
+                        event.type = MidiEvent::SUSTAIN_DOWN;
+                    return true;
+            }
+            break;
+        }
+
+        case 0xE: // Pitch wheel
+        {
+            if(size < 3)
+                return false;
+
+            // Convert to float between -1.0 and 1.0
+            unsigned value = (message[2] << 7) | message[1];
+            int centered = value - 0x2000;
+            event.type = MidiEvent::PITCH_WHEEL;
+            event.value = (float)centered / 0x2000;
+            return true;
+        }
+    }
+
+    // Anything else is passed on as is
+    if(size > MidiEvent::max_message_size)
+        return false;
+
+    event.type = MidiEvent::MESSAGE;
+    event.message_size = size;
+    for(unsigned i = 0; i < size; i++)
+        event.message[i] = message[i];
+    return true;
+}
+
+
 GenericInstrument::GenericInstrument()
-    : output_channels()
-{}
+    : output_channels(), events(1024), message_buffer()
+{
+    message_buffer.reserve(MidiEvent::max_message_size);
+}
 
 
 void GenericInstrument::add_output_channel(Channel* channel)
@@ -32,3 +105,63 @@ const unsigned GenericInstrument::get_num_output_channels()
 {
     return output_channels.size();
 }
+
+
+bool GenericInstrument::queue_event(const MidiEvent& event)
+{
+    return events.push(event);
+}
+
+
+void GenericInstrument::dispatch_events(unsigned long time)
+{
+    const MidiEvent* event;
+    while((event = events.front()) != NULL && event->time <= time)
+    {
+        unsigned long event_time = event->time;
+        if(event_time < time)
+            event_time = time;
+
+        switch(event->type)
+        {
+            case MidiEvent::NOTE_DOWN:
+                on_note_down(event->note, event->value, event_time);
+                break;
+            case MidiEvent::NOTE_UP:
+                on_note_up(event->note, event->value, event_time);
+                break;
+            case MidiEvent::SUSTAIN_DOWN:
+                on_sustain_down(event_time);
+                break;
+            case MidiEvent::SUSTAIN_UP:
+                on_sustain_up(event_time);
+                break;
+            case MidiEvent::PITCH_WHEEL:
+                on_pitch_wheel(event->value, event_time);
+                break;
+            case MidiEvent::MODULATION_WHEEL:
+                on_modulation_wheel(event->value, event_time);
+                break;
+            case MidiEvent::MESSAGE:
+                // The buffer never needs to grow past its reserved size
+                message_buffer.assign(event->message,
+                        event->message + event->message_size);
+                on_midi_message(&message_buffer, event_time);
+                break;
+        }
+
+        MidiEvent done;
+        events.pop(done);
+    }
+}
+
+
+bool GenericInstrument::next_event_time(unsigned long& time)
+{
+    const MidiEvent* event = events.front();
+    if(event == NULL)
+        return false;
+
+    time = event->time;
+    return true;
+}
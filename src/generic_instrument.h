@@ -2,6 +2,7 @@
 #define GENERIC_INSTRUMENT_H
 
 #include "audio_generics.h"
+#include "spsc_queue.h"
 
 
 namespace ClickTrack
@@ -11,6 +12,35 @@ namespace ClickTrack
     float midiNoteToFreq(unsigned note);
 
 
+    /* A parsed MIDI message, timestamped in sample time, which can be queued
+     * for an instrument. Messages without a type of their own keep their raw
+     * bytes.
+     */
+    struct MidiEvent
+    {
+        enum Type { NOTE_DOWN, NOTE_UP, SUSTAIN_DOWN, SUSTAIN_UP, PITCH_WHEEL,
+            MODULATION_WHEEL, MESSAGE };
+        Type type;
+        unsigned long time;
+
+        unsigned note;
+        float value; // velocity, or wheel position
+
+        static const unsigned max_message_size = 3;
+        unsigned char message[max_message_size];
+        unsigned message_size;
+    };
+
+
+    /* Parses a raw MIDI message into an event, leaving its time untouched.
+     * A note down with zero velocity is treated as a note up, as is common in
+     * MIDI files. Returns false if the message is too short for its status,
+     * or too long to be kept as raw bytes.
+     */
+    bool parse_midi_message(const unsigned char* message, unsigned size,
+            MidiEvent& event);
+
+
     /* The Generic Instrument is an abstract class that defines the interface
      * for a MIDI instrument class.
      *
@@ -19,6 +49,10 @@ namespace ClickTrack
      * event handlers.
      *
      * This attachment must be done at initialization time by the user.
+     *
+     * The handlers must be called from the audio thread, or between blocks.
+     * Other threads instead queue events, which the instrument applies from
+     * its own generator at the sample they are timestamped for.
      */
     class GenericInstrument
     {
@@ -59,7 +93,24 @@ namespace ClickTrack
             virtual void on_midi_message(std::vector<unsigned char>* message,
                     unsigned long time=0) = 0;
 
+            /* Queues an event from another thread. Only one thread may queue
+             * events for an instrument. Returns false and drops the event if
+             * the queue is full.
+             */
+            bool queue_event(const MidiEvent& event);
+
         protected:
+            /* Called by subclasses from the audio thread. Calls the handler
+             * of every queued event due at or before the given time. Late
+             * events are handled as if they were due at that time.
+             */
+            void dispatch_events(unsigned long time);
+
+            /* Gets the time of the next queued event. Returns false if there
+             * is none.
+             */
+            bool next_event_time(unsigned long& time);
+
             /* Used by subclasses to add their own output channels
              */
             void add_output_channel(Channel* channel);
@@ -69,6 +120,12 @@ namespace ClickTrack
              * output channels into this vector.
              */
             std::vector<Channel*> output_channels;
+
+            /* Events queued for the audio thread, and space to unpack raw
+             * messages into
+             */
+            SpscQueue<MidiEvent> events;
+            std::vector<unsigned char> message_buffer;
     };
 }
 
@@ -0,0 +1,166 @@
+#include "lattice_filter.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define LATTICE_X86
+#include <immintrin.h>
+#endif
+
+using namespace ClickTrack;
+
+
+/* Runs one lattice whose values are spaced stride apart. Used for the
+ * reference kernel and for lanes that do not fill a SIMD register.
+ */
+static void lattice_filter_strided(const SAMPLE* in, SAMPLE* out, unsigned n,
+        unsigned poles, unsigned stride, float* k, const float* dk, SAMPLE* b)
+{
+    for(unsigned t = 0; t < n; t++)
+    {
+        // Interpolate the coefficients
+        if(dk != NULL)
+        {
+            for(unsigned i = 1; i <= poles; i++)
+                k[i*stride] += dk[i*stride];
+        }
+
+        // Propogate the errors through the lattice
+        SAMPLE f = in[t*stride];
+        for(unsigned i = poles; i > 0; i--)
+        {
+            SAMPLE f_next = f + k[i*stride] * b[(i-1)*stride];
+            b[i*stride] = -k[i*stride]*f_next + b[(i-1)*stride];
+            f = f_next;
+        }
+
+        b[0] = f;
+        out[t*stride] = f;
+    }
+}
+
+
+#ifdef LATTICE_X86
+/* Runs four lattices at once with SSE
+ */
+static void lattice_filter_sse(const SAMPLE* in, SAMPLE* out, unsigned n,
+        unsigned poles, unsigned stride, float* k, const float* dk, SAMPLE* b)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for(unsigned t = 0; t < n; t++)
+    {
+        if(dk != NULL)
+        {
+            for(unsigned i = 1; i <= poles; i++)
+                _mm_storeu_ps(k + i*stride, _mm_add_ps(
+                        _mm_loadu_ps(k + i*stride),
+                        _mm_loadu_ps(dk + i*stride)));
+        }
+
+        __m128 f = _mm_loadu_ps(in + t*stride);
+        for(unsigned i = poles; i > 0; i--)
+        {
+            __m128 ki = _mm_loadu_ps(k + i*stride);
+            __m128 bi = _mm_loadu_ps(b + (i-1)*stride);
+            __m128 f_next = _mm_add_ps(f, _mm_mul_ps(ki, bi));
+            _mm_storeu_ps(b + i*stride, _mm_add_ps(
+                    _mm_mul_ps(_mm_xor_ps(ki, sign), f_next), bi));
+            f = f_next;
+        }
+
+        _mm_storeu_ps(b, f);
+        _mm_storeu_ps(out + t*stride, f);
+    }
+}
+
+
+/* Runs eight lattices at once with AVX. Only called once the CPU is known to
+ * support it.
+ */
+__attribute__((target("avx2")))
+static void lattice_filter_avx2(const SAMPLE* in, SAMPLE* out, unsigned n,
+        unsigned poles, unsigned stride, float* k, const float* dk, SAMPLE* b)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for(unsigned t = 0; t < n; t++)
+    {
+        if(dk != NULL)
+        {
+            for(unsigned i = 1; i <= poles; i++)
+                _mm256_storeu_ps(k + i*stride, _mm256_add_ps(
+                        _mm256_loadu_ps(k + i*stride),
+                        _mm256_loadu_ps(dk + i*stride)));
+        }
+
+        __m256 f = _mm256_loadu_ps(in + t*stride);
+        for(unsigned i = poles; i > 0; i--)
+        {
+            __m256 ki = _mm256_loadu_ps(k + i*stride);
+            __m256 bi = _mm256_loadu_ps(b + (i-1)*stride);
+            __m256 f_next = _mm256_add_ps(f, _mm256_mul_ps(ki, bi));
+            _mm256_storeu_ps(b + i*stride, _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_xor_ps(ki, sign), f_next), bi));
+            f = f_next;
+        }
+
+        _mm256_storeu_ps(b, f);
+        _mm256_storeu_ps(out + t*stride, f);
+    }
+}
+
+
+static bool cpu_has_avx2()
+{
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+
+void ClickTrack::lattice_filter_scalar(const SAMPLE* in, SAMPLE* out,
+        unsigned n, unsigned poles, float* k, const float* dk, SAMPLE* b)
+{
+    lattice_filter_strided(in, out, n, poles, 1, k, dk, b);
+}
+
+
+void ClickTrack::lattice_filter(const SAMPLE* in, SAMPLE* out, unsigned n,
+        unsigned poles, unsigned lanes, float* k, const float* dk, SAMPLE* b)
+{
+    lattice_filter(in, out, n, poles, lanes, lanes, k, dk, b);
+}
+
+
+void ClickTrack::lattice_filter(const SAMPLE* in, SAMPLE* out, unsigned n,
+        unsigned poles, unsigned lanes, unsigned stride, float* k,
+        const float* dk, SAMPLE* b)
+{
+    unsigned lane = 0;
+
+#ifdef LATTICE_X86
+    if(cpu_has_avx2())
+    {
+        for(; lane + 8 <= lanes; lane += 8)
+            lattice_filter_avx2(in + lane, out + lane, n, poles, stride,
+                    k + lane, dk == NULL ? NULL : dk + lane, b + lane);
+    }
+
+    for(; lane + 4 <= lanes; lane += 4)
+        lattice_filter_sse(in + lane, out + lane, n, poles, stride,
+                k + lane, dk == NULL ? NULL : dk + lane, b + lane);
+#endif
+
+    for(; lane < lanes; lane++)
+        lattice_filter_strided(in + lane, out + lane, n, poles, stride,
+                k + lane, dk == NULL ? NULL : dk + lane, b + lane);
+}
+
+
+unsigned ClickTrack::lattice_simd_lanes()
+{
+#ifdef LATTICE_X86
+    if(cpu_has_avx2())
+        return 8;
+    return 4;
+#else
+    return 1;
+#endif
+}
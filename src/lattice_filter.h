@@ -0,0 +1,63 @@
+#ifndef LATTICE_FILTER_H
+#define LATTICE_FILTER_H
+
+#include "portaudio_wrapper.h"
+
+
+namespace ClickTrack
+{
+    /* Kernels for an all pole lattice filter, as trained by the MATLAB code
+     * and used by the vocalist. For each sample of input x, a lattice of P
+     * poles computes:
+     *
+     *     f[P] = x
+     *     f[i-1] = f[i] + k[i]*b[i-1]      for i = P..1
+     *     b[i] = -k[i]*f[i-1] + b[i-1]
+     *     b[0] = f[0], and the output is f[0]
+     *
+     * This matches mtlb/latticeFilter.m. The reflection coefficients k and
+     * the backward errors b each hold P+1 values; k[0] is never used. If
+     * a coefficient delta dk is given, every k[i] is incremented by dk[i]
+     * before each sample is filtered, to interpolate between sounds.
+     *
+     * Every kernel performs exactly the same float operations in the same
+     * order, so all of them produce bit for bit identical results.
+     */
+
+    /* The scalar reference kernel. Filters n samples through one lattice.
+     * dk may be NULL.
+     */
+    void lattice_filter_scalar(const SAMPLE* in, SAMPLE* out, unsigned n,
+            unsigned poles, float* k, const float* dk, SAMPLE* b);
+
+    /* Filters n samples through several independent lattices at once. The
+     * recursion within one lattice is serial, so SIMD lanes are filled with
+     * separate voices instead.
+     *
+     * All arrays are interleaved by lane: value i of lane l is stored at
+     * index i*lanes + l. This applies to the input and output samples as well
+     * as to k, dk and b. dk may be NULL.
+     *
+     * Groups of lanes are run with AVX2 or SSE when the CPU supports them,
+     * and any left over lanes with the scalar kernel.
+     */
+    void lattice_filter(const SAMPLE* in, SAMPLE* out, unsigned n,
+            unsigned poles, unsigned lanes, float* k, const float* dk,
+            SAMPLE* b);
+
+    /* As above, but the arrays are interleaved by stride lanes and only the
+     * first lanes of them are filtered. The rest are left untouched, so idle
+     * lattices can be skipped by keeping them at the end.
+     */
+    void lattice_filter(const SAMPLE* in, SAMPLE* out, unsigned n,
+            unsigned poles, unsigned lanes, unsigned stride, float* k,
+            const float* dk, SAMPLE* b);
+
+    /* Returns the widest number of lanes the CPU can run at once; 8 with AVX2,
+     * 4 with SSE and 1 otherwise. Lane counts that are a multiple of this
+     * run fastest.
+     */
+    unsigned lattice_simd_lanes();
+}
+
+#endif
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cmath>
+#include "lpc.h"
+
+using namespace ClickTrack;
+
+
+void ClickTrack::fit_envelope(const std::vector<float>& x,
+        unsigned sample_rate, std::vector<double>& envelope)
+{
+    const double attack = exp(-1.0 / (sample_rate * 0.001));
+    const double release = exp(-1.0 / (sample_rate * 0.1));
+
+    envelope.assign(x.size(), 0.0);
+    for(unsigned long i = 1; i < x.size(); i++)
+    {
+        double level = fabs(x[i]);
+        double alpha = level > envelope[i-1] ? attack : release;
+        envelope[i] = alpha*envelope[i-1] + (1-alpha)*level;
+    }
+}
+
+
+/* Finds the first and last sample of each note of a recording: every
+ * stretch of at least a second where its normalized envelope exceeds the
+ * threshold. Returns the peak of the recording, or zero if it is silent.
+ */
+static float find_notes(const std::vector<float>& x, float threshold,
+        unsigned sample_rate,
+        std::vector< std::pair<unsigned long, unsigned long> >& notes)
+{
+    notes.clear();
+
+    // Follow the envelope of the normalized recording
+    float peak = 0.0;
+    for(unsigned long i = 0; i < x.size(); i++)
+        peak = std::max(peak, (float) fabs(x[i]));
+    if(peak == 0.0)
+        return peak;
+
+    std::vector<float> normalized(x.size());
+    for(unsigned long i = 0; i < x.size(); i++)
+        normalized[i] = x[i] / peak;
+    std::vector<double> envelope;
+    fit_envelope(normalized, sample_rate, envelope);
+
+    // Find each stretch above the threshold. The envelope starts at zero, so
+    // a stretch begins at the last sample below it. A stretch still going at
+    // the end of the recording is incomplete, and is dropped.
+    const unsigned long min_length = sample_rate;
+    unsigned long start = 0;
+    bool above = false;
+    for(unsigned long i = 1; i < x.size(); i++)
+    {
+        bool now_above = envelope[i] > threshold;
+        if(now_above && !above)
+            start = i - 1;
+        else if(!now_above && above && i - 1 - start >= min_length)
+            notes.push_back(std::make_pair(start, i - 1));
+        above = now_above;
+    }
+
+    return peak;
+}
+
+
+std::vector< std::vector<float> > ClickTrack::segment_recording(
+        const std::vector<float>& x, float threshold, unsigned sample_rate)
+{
+    std::vector< std::vector<float> > segments;
+    std::vector< std::pair<unsigned long, unsigned long> > notes;
+    find_notes(x, threshold, sample_rate, notes);
+
+    const unsigned long trim = 10000UL * sample_rate / 44100;
+    for(unsigned i = 0; i < notes.size(); i++)
+    {
+        // Strip the beginning and end, and normalize
+        std::vector<float> segment(x.begin() + notes[i].first + trim,
+                x.begin() + notes[i].second - trim + 1);
+
+        float segment_peak = 0.0;
+        for(unsigned long j = 0; j < segment.size(); j++)
+            segment_peak = std::max(segment_peak, (float) fabs(segment[j]));
+        for(unsigned long j = 0; j < segment.size(); j++)
+            segment[j] /= segment_peak;
+
+        segments.push_back(segment);
+    }
+
+    return segments;
+}
+
+
+unsigned ClickTrack::fit_trajectory(const std::vector<float>& x,
+        float threshold, unsigned sample_rate, unsigned poles,
+        unsigned num_frames, unsigned hop_size, unsigned window_size,
+        std::vector< std::vector<float> >& ks)
+{
+    std::vector< std::pair<unsigned long, unsigned long> > notes;
+    find_notes(x, threshold, sample_rate, notes);
+
+    std::vector<float> window(window_size);
+    for(unsigned i = 0; i < window_size; i++)
+        window[i] = 0.5 - 0.5*cos(2*M_PI*(i + 0.5)/window_size);
+
+    // Sum the autocorrelation of each frame over every note, each note
+    // normalized to a peak of one over the frames
+    const unsigned long span = (num_frames-1)*hop_size + window_size;
+    std::vector< std::vector<double> > phis(num_frames,
+            std::vector<double>(poles + 1, 0.0));
+    std::vector<double> phi(poles + 1);
+    std::vector<float> frame(window_size);
+    unsigned used = 0;
+    for(unsigned i = 0; i < notes.size(); i++)
+    {
+        unsigned long onset = notes[i].first;
+        if(onset + span > x.size())
+            continue;
+
+        float peak = 0.0;
+        for(unsigned long j = onset; j < onset + span; j++)
+            peak = std::max(peak, (float) fabs(x[j]));
+        if(peak == 0.0)
+            continue;
+
+        for(unsigned f = 0; f < num_frames; f++)
+        {
+            const float* in = &x[onset + f*hop_size];
+            for(unsigned j = 0; j < window_size; j++)
+                frame[j] = in[j] / peak * window[j];
+
+            autocorrelate_direct(&frame[0], window_size, poles, &phi[0]);
+            for(unsigned lag = 0; lag <= poles; lag++)
+                phis[f][lag] += phi[lag];
+        }
+        used++;
+    }
+
+    ks.assign(num_frames, std::vector<float>(poles, 0.0));
+    if(used == 0)
+        return 0;
+
+    std::vector<double> alphas(poles + 1);
+    for(unsigned f = 0; f < num_frames; f++)
+        levinson_durbin(&phis[f][0], poles, &ks[f][0], &alphas[0]);
+
+    return used;
+}
+
+
+void ClickTrack::autocorrelate(const float* x, unsigned long n,
+        unsigned max_lag, double* phi)
+{
+    // Summing directly is cheaper for up to about 50 lags; see lpc_bench
+    if(max_lag < 50)
+    {
+        autocorrelate_direct(x, n, max_lag, phi);
+        return;
+    }
+
+    Autocorrelator autocorrelator(max_lag);
+    autocorrelator.add(x, n);
+    autocorrelator.finish(phi);
+}
+
+
+void ClickTrack::autocorrelate_direct(const float* x, unsigned long n,
+        unsigned max_lag, double* phi)
+{
+    for(unsigned lag = 0; lag <= max_lag; lag++)
+    {
+        double sum = 0.0;
+        for(unsigned long i = lag; i < n; i++)
+            sum += (double) x[i] * x[i - lag];
+        phi[lag] = sum;
+    }
+}
+
+
+float ClickTrack::levinson_durbin(const double* phi, unsigned poles,
+        float* ks)
+{
+    std::vector<double> alphas(poles + 1);
+    return levinson_durbin(phi, poles, ks, &alphas[0]);
+}
+
+
+float ClickTrack::levinson_durbin(const double* phi, unsigned poles,
+        float* ks, double* alphas)
+{
+    for(unsigned i = 0; i <= poles; i++)
+        alphas[i] = 0.0;
+    for(unsigned i = 0; i < poles; i++)
+        ks[i] = 0.0;
+
+    double error = phi[0];
+    for(unsigned i = 1; i <= poles && error > 0.0; i++)
+    {
+        // Find the reflection coefficient from the prediction so far
+        double k = phi[i];
+        for(unsigned j = 1; j < i; j++)
+            k -= alphas[j] * phi[i - j];
+        k /= error;
+        ks[i-1] = k;
+
+        // Step the polynomial up an order in place, a pair of terms at once
+        for(unsigned j = 1; j <= (i-1)/2; j++)
+        {
+            double low = alphas[j];
+            double high = alphas[i - j];
+            alphas[j] = low - k*high;
+            alphas[i - j] = high - k*low;
+        }
+        if((i-1) % 2 == 1)
+        {
+            unsigned j = (i-1)/2 + 1;
+            alphas[j] -= k*alphas[j];
+        }
+        alphas[i] = k;
+
+        error *= 1 - k*k;
+    }
+
+    // The gain is the residual error of the final predictor
+    double residual = phi[0];
+    for(unsigned j = 1; j <= poles; j++)
+        residual -= alphas[j] * phi[j];
+    return residual > 0.0 ? sqrt(residual) : 0.0;
+}
+
+
+float ClickTrack::compute_lpc(const float* x, unsigned long n,
+        unsigned poles, float* ks)
+{
+    std::vector<double> phi(poles + 1);
+    autocorrelate(x, n, poles, &phi[0]);
+    return levinson_durbin(&phi[0], poles, ks);
+}
+
+
+
+
+static unsigned fft_size_for(unsigned max_lag)
+{
+    unsigned size = 1024;
+    while(size < 4*max_lag)
+        size *= 2;
+    return size;
+}
+
+
+Autocorrelator::Autocorrelator(unsigned in_max_lag)
+    : max_lag(in_max_lag), fft(fft_size_for(in_max_lag)),
+      block_size(fft.get_size() - in_max_lag), pending(), phi(in_max_lag + 1),
+      block(fft.get_size()), extended(fft.get_size()),
+      correlation(fft.get_size()), block_spectrum(fft.get_size()/2 + 1),
+      extended_spectrum(fft.get_size()/2 + 1)
+{
+    pending.reserve(block_size + max_lag);
+}
+
+
+void Autocorrelator::add(const float* x, unsigned long n)
+{
+    while(n > 0)
+    {
+        // Fill up to a whole block and the samples that follow it
+        unsigned long wanted = block_size + max_lag - pending.size();
+        unsigned long taken = std::min(n, wanted);
+        pending.insert(pending.end(), x, x + taken);
+        x += taken;
+        n -= taken;
+
+        if(pending.size() == block_size + max_lag)
+            process_block(block_size);
+    }
+}
+
+
+void Autocorrelator::finish(double* out)
+{
+    // The last blocks have fewer samples after them
+    while(!pending.empty())
+        process_block(std::min((unsigned long) block_size, pending.size()));
+
+    for(unsigned lag = 0; lag <= max_lag; lag++)
+    {
+        out[lag] = phi[lag];
+        phi[lag] = 0.0;
+    }
+}
+
+
+void Autocorrelator::process_block(unsigned n)
+{
+    // The block, and the block with the samples after it, both zero padded
+    // so that the correlation does not wrap around
+    const unsigned size = fft.get_size();
+    const unsigned extended_n = std::min((unsigned long) n + max_lag,
+            pending.size());
+    std::copy(pending.begin(), pending.begin() + n, block.begin());
+    std::fill(block.begin() + n, block.end(), 0.0);
+    std::copy(pending.begin(), pending.begin() + extended_n,
+            extended.begin());
+    std::fill(extended.begin() + extended_n, extended.end(), 0.0);
+
+    // Correlate them by multiplying the spectrum of the samples after by
+    // the conjugate of the block's
+    fft.forward(&block[0], &block_spectrum[0]);
+    fft.forward(&extended[0], &extended_spectrum[0]);
+    for(unsigned k = 0; k <= size/2; k++)
+    {
+        const std::complex<double>& a = block_spectrum[k];
+        const std::complex<double>& b = extended_spectrum[k];
+        extended_spectrum[k] = std::complex<double>(
+                a.real()*b.real() + a.imag()*b.imag(),
+                a.real()*b.imag() - a.imag()*b.real());
+    }
+    fft.inverse(&extended_spectrum[0], &correlation[0]);
+
+    for(unsigned lag = 0; lag <= max_lag; lag++)
+        phi[lag] += correlation[lag];
+
+    pending.erase(pending.begin(), pending.begin() + n);
+}
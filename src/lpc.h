@@ -0,0 +1,130 @@
+#ifndef LPC_H
+#define LPC_H
+
+#include <vector>
+#include "fft.h"
+
+
+namespace ClickTrack
+{
+    /* Linear predictive coding, used to train the all pole lattice models the
+     * vocalist sings through. These follow the MATLAB training code in
+     * /mtlb/, and produce the same models.
+     */
+
+    /* Follows the envelope of a signal with a leaky integrator, which
+     * attacks in 1ms and releases in 100ms. As mtlb/fitEnvelope.m. The
+     * envelope is kept in double precision, so that it crosses a threshold
+     * on the same sample as in MATLAB.
+     */
+    void fit_envelope(const std::vector<float>& x, unsigned sample_rate,
+            std::vector<double>& envelope);
+
+    /* Splits a recording into each stretch where its normalized envelope
+     * exceeds the threshold. Stretches under a second long are ignored, the
+     * rest have 10000 samples at 44.1kHz trimmed from both ends, and each is
+     * normalized to a peak of one. As mtlb/segmentRecording.m.
+     */
+    std::vector< std::vector<float> > segment_recording(
+            const std::vector<float>& x, float threshold,
+            unsigned sample_rate);
+
+    /* Fits a trajectory of models through the start of every note in a
+     * recording, as mtlb/lpcSeries.m fits a series through one signal.
+     * Frame f models a Hann window of window_size samples, hop_size*f
+     * samples after each note begins, with its autocorrelation summed over
+     * every note. Notes are found as by segment_recording, but are not
+     * trimmed.
+     *
+     * Writes num_frames rows of poles reflection coefficients into ks, and
+     * returns the number of notes fit. If there were none, every
+     * coefficient is zero.
+     */
+    unsigned fit_trajectory(const std::vector<float>& x, float threshold,
+            unsigned sample_rate, unsigned poles, unsigned num_frames,
+            unsigned hop_size, unsigned window_size,
+            std::vector< std::vector<float> >& ks);
+
+    /* Computes the autocorrelation of n samples for lags 0 to max_lag, into
+     * phi. Uses an Autocorrelator once there are enough lags for it to be
+     * faster, and sums directly otherwise.
+     */
+    void autocorrelate(const float* x, unsigned long n, unsigned max_lag,
+            double* phi);
+
+    /* The direct sum, costing max_lag+1 multiplies per sample
+     */
+    void autocorrelate_direct(const float* x, unsigned long n,
+            unsigned max_lag, double* phi);
+
+
+    /* Computes the autocorrelation of a signal for lags 0 to max_lag with
+     * FFTs, as the signal is streamed in. Its cost barely grows with the
+     * number of lags.
+     *
+     * The signal is cut into blocks. Each block is correlated with itself
+     * and the max_lag samples that follow it, by multiplying their spectra,
+     * and the results of every block are added together. Only the latest
+     * block and the samples after it are held, however long the signal.
+     */
+    class Autocorrelator
+    {
+        public:
+            /* The FFT size is the smallest power of two of at least 1024
+             * that leaves blocks of at least three times max_lag
+             */
+            Autocorrelator(unsigned max_lag);
+
+            /* Adds the next n samples of the signal
+             */
+            void add(const float* x, unsigned long n);
+
+            /* Finishes the signal, writes the max_lag+1 lags of its
+             * autocorrelation into phi, and starts a new signal
+             */
+            void finish(double* phi);
+
+        private:
+            /* Correlates the first n samples held with those up to max_lag
+             * samples later, and drops them
+             */
+            void process_block(unsigned n);
+
+            const unsigned max_lag;
+            RealFft fft;
+            const unsigned block_size;
+
+            std::vector<double> pending;
+            std::vector<double> phi;
+
+            /* Statically allocated buffers
+             */
+            std::vector<double> block, extended, correlation;
+            std::vector< std::complex<double> > block_spectrum,
+                extended_spectrum;
+    };
+
+    /* Runs the Levinson-Durbin recursion on the autocorrelation phi, of
+     * poles+1 lags, to find the reflection coefficients ks of an all pole
+     * lattice with that many poles. Returns the gain of the model.
+     *
+     * If the prediction error reaches zero, the remaining coefficients are
+     * zero.
+     */
+    float levinson_durbin(const double* phi, unsigned poles, float* ks);
+
+    /* The same, without allocating, for use on the audio thread. The
+     * predictor polynomial is built in alphas, which must hold poles+1
+     * values.
+     */
+    float levinson_durbin(const double* phi, unsigned poles, float* ks,
+            double* alphas);
+
+    /* Computes an all pole model of n samples. Writes poles reflection
+     * coefficients into ks, and returns the gain. As mtlb/computeLpc.m.
+     */
+    float compute_lpc(const float* x, unsigned long n, unsigned poles,
+            float* ks);
+}
+
+#endif
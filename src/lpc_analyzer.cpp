@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+#include "lpc.h"
+#include "lpc_analyzer.h"
+
+using namespace ClickTrack;
+
+
+/* Builds an empty model of the given size, to allocate every copy of the
+ * published model up front
+ */
+static LpcAnalyzer::Model empty_model(unsigned poles)
+{
+    LpcAnalyzer::Model model;
+    model.time = 0;
+    model.gain = 0.0;
+    model.ks.assign(poles, 0.0);
+    return model;
+}
+
+
+LpcAnalyzer::LpcAnalyzer(unsigned in_poles, float window_ms, float hop_ms)
+    : AudioConsumer(1), poles(in_poles),
+      window_size(std::max(in_poles + 1, (unsigned) (window_ms*SAMPLE_RATE/1000))),
+      hop_size(std::max(1u, (unsigned) (hop_ms*SAMPLE_RATE/1000))),
+      history(window_size, 0.0), history_pos(0), until_analysis(window_size),
+      window(window_size), frame(window_size), phi(in_poles + 1),
+      alphas(in_poles + 1), models(empty_model(in_poles))
+{
+    for(unsigned i = 0; i < window_size; i++)
+        window[i] = 0.5 - 0.5*cos(2*M_PI*(i + 0.5)/window_size);
+}
+
+
+bool LpcAnalyzer::update_model()
+{
+    return models.update();
+}
+
+
+const LpcAnalyzer::Model& LpcAnalyzer::get_model()
+{
+    return models.get_read_buffer();
+}
+
+
+unsigned LpcAnalyzer::get_poles()
+{
+    return poles;
+}
+
+
+void LpcAnalyzer::process_inputs(std::vector<SAMPLE>& inputs, unsigned long t)
+{
+    add_samples(&inputs[0], 1, t);
+}
+
+
+void LpcAnalyzer::process_block(std::vector< std::vector<SAMPLE> >& inputs,
+        unsigned long t)
+{
+    add_samples(&inputs[0][0], BUFFER_SIZE, t);
+}
+
+
+void LpcAnalyzer::add_samples(const SAMPLE* in, unsigned n, unsigned long t)
+{
+    // Add samples up to each analysis in turn
+    while(n > 0)
+    {
+        unsigned count = std::min(n, until_analysis);
+        for(unsigned i = 0; i < count; i++)
+        {
+            history[history_pos] = in[i];
+            history_pos = history_pos + 1 == window_size ? 0 : history_pos + 1;
+        }
+        in += count;
+        n -= count;
+        t += count;
+        until_analysis -= count;
+
+        if(until_analysis == 0)
+        {
+            analyze(t);
+            until_analysis = hop_size;
+        }
+    }
+}
+
+
+void LpcAnalyzer::analyze(unsigned long t)
+{
+    // Window the latest audio, oldest first
+    for(unsigned i = 0; i < window_size; i++)
+    {
+        unsigned j = history_pos + i;
+        if(j >= window_size)
+            j -= window_size;
+        frame[i] = history[j] * window[i];
+    }
+
+    // Skip windows quieter than about -60dB, which have no shape to fit
+    autocorrelate_direct(&frame[0], window_size, poles, &phi[0]);
+    if(phi[0] < 1e-6 * window_size)
+        return;
+
+    Model& model = models.get_write_buffer();
+    model.time = t;
+    model.gain = levinson_durbin(&phi[0], poles, &model.ks[0], &alphas[0]);
+    models.publish();
+}
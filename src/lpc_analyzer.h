@@ -0,0 +1,76 @@
+#ifndef LPC_ANALYZER_H
+#define LPC_ANALYZER_H
+
+#include "audio_generics.h"
+#include "triple_buffer.h"
+
+
+namespace ClickTrack
+{
+    /* The LPC analyzer consumes a live signal, such as a microphone, and fits
+     * an all pole model of the vocal tract to it as it streams in, in the
+     * form the vocalist sings through. As mtlb/lpcSeries.m does offline,
+     * a new model is fit every hop, here from a Hann window of the latest
+     * audio.
+     *
+     * The analysis runs on the audio thread and never allocates. Each model
+     * is published without locks, and may be read from any one other thread,
+     * or from another node in the same graph. Windows too quiet to fit are
+     * skipped, so the last model heard is kept through silence.
+     */
+    class LpcAnalyzer : public AudioConsumer
+    {
+        public:
+            LpcAnalyzer(unsigned poles = 100, float window_ms = 30,
+                    float hop_ms = 10);
+
+            /* A fitted model. The gain is that of the windowed audio.
+             */
+            struct Model
+            {
+                unsigned long time; // just after the last sample of the window
+                float gain;
+                std::vector<float> ks;
+            };
+
+            /* Fetches the latest model, if it is newer than the one read
+             * last. Returns true if it was. Only one thread may read models.
+             */
+            bool update_model();
+            const Model& get_model();
+
+            unsigned get_poles();
+
+        private:
+            void process_inputs(std::vector<SAMPLE>& inputs, unsigned long t);
+            void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                    unsigned long t);
+
+            /* Adds samples from time t, and analyzes the window at every hop
+             */
+            void add_samples(const SAMPLE* in, unsigned n, unsigned long t);
+            void analyze(unsigned long t);
+
+            const unsigned poles;
+            const unsigned window_size;
+            const unsigned hop_size;
+
+            /* A ring of the latest window of samples, and the samples left
+             * until the next analysis
+             */
+            std::vector<SAMPLE> history;
+            unsigned history_pos;
+            unsigned until_analysis;
+
+            /* Statically allocated buffers for the analysis
+             */
+            std::vector<float> window;
+            std::vector<float> frame;
+            std::vector<double> phi;
+            std::vector<double> alphas;
+
+            TripleBuffer<Model> models;
+    };
+}
+
+#endif
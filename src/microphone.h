@@ -0,0 +1,36 @@
+#ifndef MICROPHONE_H
+#define MICROPHONE_H
+
+#include "audio_generics.h"
+#include "portaudio_wrapper.h"
+
+
+namespace ClickTrack
+{
+    /* The microphone is an input device. It uses the default input device on
+     * your computer, and outputs one channel per input channel it reads from
+     * portaudio.
+     *
+     * Reads block on the device, so the signal chain runs at the rate audio
+     * is recorded.
+     */
+    class Microphone : public AudioGenerator
+    {
+        public:
+            Microphone(unsigned num_channels = 1, bool defaultDevice=true);
+
+        private:
+            void generate_outputs(std::vector<SAMPLE>& outputs,
+                    unsigned long t);
+            void generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+                    unsigned long t);
+
+            /* Store our stream results, which are read a buffer at a time
+             */
+            std::vector< std::vector<SAMPLE> > buffer;
+            InputStream stream;
+    };
+}
+
+
+#endif
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include "midi_file.h"
+
+using namespace ClickTrack;
+
+
+/* Events in tick time, before the tempo map is applied
+ */
+struct TickEvent
+{
+    unsigned long tick;
+    MidiEvent event;
+};
+
+struct TempoChange
+{
+    unsigned long tick;
+    unsigned long micros_per_quarter;
+};
+
+static bool earlier_event(const TickEvent& a, const TickEvent& b)
+{
+    return a.tick < b.tick;
+}
+
+static bool earlier_tempo(const TempoChange& a, const TempoChange& b)
+{
+    return a.tick < b.tick;
+}
+
+
+/* Helpers to read big endian values, advancing the position. Each checks that
+ * the value lies before the end.
+ */
+static const char* truncated = "The MIDI file is truncated.";
+
+static unsigned long read_uint(const std::vector<unsigned char>& data,
+        unsigned long& pos, unsigned long end, unsigned bytes)
+{
+    if(pos + bytes > end)
+        throw MidiFileInvalid(truncated);
+
+    unsigned long value = 0;
+    for(unsigned i = 0; i < bytes; i++)
+        value = (value << 8) | data[pos++];
+    return value;
+}
+
+static unsigned long read_varlen(const std::vector<unsigned char>& data,
+        unsigned long& pos, unsigned long end)
+{
+    // Seven bits per byte, with the top bit set on all but the last
+    unsigned long value = 0;
+    for(unsigned i = 0; i < 4; i++)
+    {
+        if(pos >= end)
+            throw MidiFileInvalid(truncated);
+
+        unsigned char byte = data[pos++];
+        value = (value << 7) | (byte & 0x7F);
+        if(!(byte & 0x80))
+            return value;
+    }
+    throw MidiFileInvalid("The MIDI file has an overlong length.");
+}
+
+
+/* Reads the events of one track chunk, and any tempo changes in it
+ */
+static void read_track(const std::vector<unsigned char>& data,
+        unsigned long pos, unsigned long end, int channel,
+        std::vector<TickEvent>& events, std::vector<TempoChange>& tempos)
+{
+    unsigned long tick = 0;
+    unsigned char status = 0;
+    while(pos < end)
+    {
+        tick += read_varlen(data, pos, end);
+        unsigned char byte = read_uint(data, pos, end, 1);
+
+        // Meta events
+        if(byte == 0xFF)
+        {
+            unsigned char type = read_uint(data, pos, end, 1);
+            unsigned long length = read_varlen(data, pos, end);
+            if(pos + length > end)
+                throw MidiFileInvalid(truncated);
+
+            if(type == 0x2F) // end of track
+                return;
+            if(type == 0x51 && length == 3) // tempo
+            {
+                TempoChange tempo = {tick, read_uint(data, pos, end, 3)};
+                tempos.push_back(tempo);
+            }
+            else
+                pos += length;
+
+            status = 0;
+            continue;
+        }
+
+        // System exclusive messages are skipped
+        if(byte == 0xF0 || byte == 0xF7)
+        {
+            unsigned long length = read_varlen(data, pos, end);
+            if(pos + length > end)
+                throw MidiFileInvalid(truncated);
+            pos += length;
+
+            status = 0;
+            continue;
+        }
+
+        // Channel messages, which may reuse the last status
+        unsigned char message[3];
+        if(byte & 0x80)
+            status = byte;
+        else if(status != 0)
+            pos--;
+        else
+            throw MidiFileInvalid("The MIDI file has a data byte without "
+                    "a status.");
+
+        if(status >= 0xF0)
+            throw MidiFileInvalid("The MIDI file has an unexpected system "
+                    "message.");
+
+        unsigned char type = status >> 4;
+        unsigned size = (type == 0xC || type == 0xD) ? 2 : 3;
+        message[0] = status;
+        for(unsigned i = 1; i < size; i++)
+            message[i] = read_uint(data, pos, end, 1);
+
+        // Keep only the messages an instrument responds to
+        if(type != 0x8 && type != 0x9 && type != 0xB && type != 0xE)
+            continue;
+        if(channel >= 0 && (status & 0x0F) != channel)
+            continue;
+
+        TickEvent event;
+        event.tick = tick;
+        event.event = MidiEvent();
+        parse_midi_message(message, size, event.event);
+        events.push_back(event);
+    }
+}
+
+
+std::vector<MidiEvent> ClickTrack::read_midi_file(const std::string& path,
+        int channel)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if(!file)
+        throw MidiFileInvalid("The MIDI file could not be opened.");
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+
+    // Read the header chunk
+    unsigned long pos = 0;
+    unsigned long end = data.size();
+    if(end < 14 || !std::equal(data.begin(), data.begin() + 4, "MThd"))
+        throw MidiFileInvalid("The file is not a MIDI file.");
+    pos = 4;
+    unsigned long header_length = read_uint(data, pos, end, 4);
+    if(header_length < 6)
+        throw MidiFileInvalid("The MIDI file has a short header.");
+
+    unsigned format = read_uint(data, pos, end, 2);
+    read_uint(data, pos, end, 2); // number of tracks, found by scanning
+    unsigned division = read_uint(data, pos, end, 2);
+    if(format > 1)
+        throw MidiFileInvalid("Only type 0 and 1 MIDI files are supported.");
+    if(division == 0)
+        throw MidiFileInvalid("The MIDI file has no time division.");
+    pos = 8 + header_length;
+
+    // Read every track, skipping any unknown chunks
+    std::vector<TickEvent> events;
+    std::vector<TempoChange> tempos;
+    while(pos + 8 <= end)
+    {
+        bool is_track = std::equal(data.begin() + pos,
+                data.begin() + pos + 4, "MTrk");
+        pos += 4;
+        unsigned long length = read_uint(data, pos, end, 4);
+        if(pos + length > end)
+            throw MidiFileInvalid(truncated);
+
+        if(is_track)
+            read_track(data, pos, pos + length, channel, events, tempos);
+        pos += length;
+    }
+
+    // Merging the tracks keeps their order at equal ticks
+    std::stable_sort(events.begin(), events.end(), earlier_event);
+    std::stable_sort(tempos.begin(), tempos.end(), earlier_tempo);
+
+    // Walk the tempo map alongside the events. Each tempo segment is timed
+    // from its own start, so rounding never accumulates. SMPTE divisions
+    // give a fixed number of ticks per second instead.
+    double seconds_per_tick;
+    if(division & 0x8000)
+    {
+        int fps = -(signed char)(division >> 8);
+        unsigned ticks_per_frame = division & 0xFF;
+        if(ticks_per_frame == 0)
+            throw MidiFileInvalid("The MIDI file has no ticks per frame.");
+        double frames = (fps == 29) ? 30000.0/1001 : fps;
+        seconds_per_tick = 1.0 / (frames * ticks_per_frame);
+        tempos.clear();
+    }
+    else
+        seconds_per_tick = 500000e-6 / division; // 120 BPM until told
+
+    std::vector<MidiEvent> result;
+    result.reserve(events.size());
+    unsigned next_tempo = 0;
+    unsigned long segment_tick = 0;
+    double segment_seconds = 0.0;
+    for(unsigned i = 0; i < events.size(); i++)
+    {
+        while(next_tempo < tempos.size() &&
+                tempos[next_tempo].tick <= events[i].tick)
+        {
+            segment_seconds += (tempos[next_tempo].tick - segment_tick) *
+                seconds_per_tick;
+            segment_tick = tempos[next_tempo].tick;
+            seconds_per_tick = tempos[next_tempo].micros_per_quarter * 1e-6 /
+                division;
+            next_tempo++;
+        }
+
+        double seconds = segment_seconds +
+            (events[i].tick - segment_tick) * seconds_per_tick;
+        result.push_back(events[i].event);
+        result.back().time = lround(seconds * SAMPLE_RATE);
+    }
+
+    return result;
+}
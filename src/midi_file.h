@@ -0,0 +1,47 @@
+#ifndef MIDI_FILE_H
+#define MIDI_FILE_H
+
+#include <exception>
+#include <string>
+#include <vector>
+#include "generic_instrument.h"
+
+
+namespace ClickTrack
+{
+    /* Reads a Standard MIDI File of type 0 or 1, and converts it into events
+     * that can be queued for any instrument.
+     *
+     * Tick times are converted to sample times using the file's tempo map,
+     * or its SMPTE time division if it has one, so every event is scheduled
+     * for the exact sample it falls on. The tracks are merged, and the events
+     * are returned sorted by time; events at the same time keep their order
+     * by track, then by their position in the track.
+     *
+     * Notes, sustain, the pitch and modulation wheels and other control
+     * changes are kept. If a channel from 0 to 15 is given, only its events
+     * are kept.
+     *
+     * Throws MidiFileInvalid if the file cannot be read or is malformed.
+     */
+    std::vector<MidiEvent> read_midi_file(const std::string& path,
+            int channel = -1);
+
+
+    /* Exception thrown when a MIDI file cannot be read
+     */
+    class MidiFileInvalid: public std::exception
+    {
+        public:
+            MidiFileInvalid(const char* in_reason)
+                : reason(in_reason) {}
+
+            const char* reason;
+            virtual const char* what() const throw()
+            {
+                return reason;
+            }
+    };
+}
+
+#endif
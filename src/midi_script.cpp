@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "midi_script.h"
+
+using namespace ClickTrack;
+
+
+/* Orders events by time only, for a stable sort
+ */
+static bool earlier(const MidiEvent& a, const MidiEvent& b)
+{
+    return a.time < b.time;
+}
+
+
+std::vector<MidiEvent> ClickTrack::read_midi_script(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+        throw MidiScriptError(path, 0);
+
+    std::vector<MidiEvent> events;
+    std::string line;
+    for(unsigned line_number = 1; std::getline(file, line); line_number++)
+    {
+        // Strip comments and skip blank lines
+        size_t comment = line.find('#');
+        if(comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream words(line);
+        std::string name;
+        MidiEvent event = MidiEvent();
+        if(!(words >> event.time))
+        {
+            if(line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            throw MidiScriptError(path, line_number);
+        }
+        if(!(words >> name))
+            throw MidiScriptError(path, line_number);
+
+        bool ok = true;
+        if(name == "note_down" || name == "note_up")
+        {
+            event.type = name == "note_down" ?
+                MidiEvent::NOTE_DOWN : MidiEvent::NOTE_UP;
+            ok = (bool)(words >> event.note) && event.note < 128;
+            if(ok && !(words >> event.value))
+            {
+                event.value = 1.0;
+                words.clear();
+            }
+        }
+        else if(name == "sustain_down")
+            event.type = MidiEvent::SUSTAIN_DOWN;
+        else if(name == "sustain_up")
+            event.type = MidiEvent::SUSTAIN_UP;
+        else if(name == "pitch_wheel")
+        {
+            event.type = MidiEvent::PITCH_WHEEL;
+            ok = (bool)(words >> event.value);
+        }
+        else if(name == "mod_wheel")
+        {
+            event.type = MidiEvent::MODULATION_WHEEL;
+            ok = (bool)(words >> event.value);
+        }
+        else if(name == "message")
+        {
+            event.type = MidiEvent::MESSAGE;
+            unsigned byte;
+            while(ok && words >> byte)
+            {
+                ok = byte < 256 &&
+                    event.message_size < MidiEvent::max_message_size;
+                if(ok)
+                    event.message[event.message_size++] = byte;
+            }
+            ok = ok && event.message_size > 0;
+            words.clear();
+        }
+        else
+            ok = false;
+
+        // Reject anything left over on the line
+        std::string extra;
+        if(!ok || words >> extra)
+            throw MidiScriptError(path, line_number);
+
+        events.push_back(event);
+    }
+
+    std::stable_sort(events.begin(), events.end(), earlier);
+    return events;
+}
+
+
+
+
+MidiScriptError::MidiScriptError(const std::string& path, unsigned line)
+    : message()
+{
+    std::ostringstream out;
+    if(line == 0)
+        out << "Could not read MIDI script " << path << ".";
+    else
+        out << "Could not parse line " << line << " of MIDI script " <<
+            path << ".";
+    message = out.str();
+}
@@ -0,0 +1,53 @@
+#ifndef MIDI_SCRIPT_H
+#define MIDI_SCRIPT_H
+
+#include <exception>
+#include <string>
+#include <vector>
+#include "generic_instrument.h"
+
+
+namespace ClickTrack
+{
+    /* Reads a script of timestamped MIDI events from a text file, so that
+     * an instrument can be played offline without a MIDI device. Each line
+     * holds the sample time of an event, its name and its arguments:
+     *
+     *     0       note_down NOTE [VELOCITY]
+     *     22050   note_up NOTE [VELOCITY]
+     *     44100   sustain_down
+     *     44100   sustain_up
+     *     48000   pitch_wheel VALUE        (-1 to 1)
+     *     48000   mod_wheel VALUE          (0 to 1)
+     *     48000   message BYTE [BYTE [BYTE]]
+     *
+     * Velocities default to 1. Anything after a # is a comment. The events
+     * are returned sorted by time; events at the same time keep their order
+     * in the file.
+     *
+     * Throws MidiScriptError if the file cannot be read or a line cannot be
+     * parsed.
+     */
+    std::vector<MidiEvent> read_midi_script(const std::string& path);
+
+
+    /* Exception thrown when reading a script fails
+     */
+    class MidiScriptError: public std::exception
+    {
+        public:
+            MidiScriptError(const std::string& path, unsigned line);
+
+            virtual const char* what() const throw()
+            {
+                return message.c_str();
+            }
+
+            ~MidiScriptError() throw() {}
+
+        private:
+            std::string message;
+    };
+}
+
+#endif
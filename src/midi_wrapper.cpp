@@ -10,7 +10,7 @@ namespace chr = std::chrono;
 
 MidiListener::MidiListener(GenericInstrument* in_inst, int channel)
     : stream(), inst(in_inst), 
-      buffer_timestamp(chr::high_resolution_clock::now()), next_buffer_time(0)
+      timing_sequence(0), buffer_timestamp(0), next_buffer_time(0)
 {
     // If no channel specified, ask the user for a channel
     if(channel == -1)
@@ -51,92 +51,57 @@ void MidiListener::midi_callback(double deltaTime, std::vector<unsigned char>* m
         return;
     }
 
+    // Read the time and timestamp of the same buffer, retrying if the audio
+    // thread published a new one meanwhile
+    unsigned long buffer_time;
+    long long buffer_timestamp;
+    unsigned sequence;
+    do
+    {
+        sequence = listener->timing_sequence.load(std::memory_order_acquire);
+        buffer_time =
+            listener->next_buffer_time.load(std::memory_order_relaxed);
+        buffer_timestamp =
+            listener->buffer_timestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while(sequence % 2 != 0 || sequence !=
+            listener->timing_sequence.load(std::memory_order_relaxed));
+
     // Get the offset, delay by one frame, if we have received callback info
-    unsigned long time = 0;
-    if(listener->next_buffer_time != 0) 
+    MidiEvent event;
+    event.time = 0;
+    if(buffer_time != 0) 
     {
-        auto diff = chr::high_resolution_clock::now() - 
-            listener->buffer_timestamp;
-        double nanos = chr::duration_cast<chr::nanoseconds>(diff).count();
-        unsigned long delay = nanos / 1e9 * SAMPLE_RATE;
-        time = listener->next_buffer_time + BUFFER_SIZE + delay;
+        long long now = chr::duration_cast<chr::nanoseconds>(
+                chr::steady_clock::now().time_since_epoch()).count();
+        double nanos = now - buffer_timestamp;
+        unsigned long delay = nanos > 0 ? nanos / 1e9 * SAMPLE_RATE : 0;
+        event.time = buffer_time + BUFFER_SIZE + delay;
     }
 
-    // Cast listener to correct type, then case on message type
-    GenericInstrument* inst = listener->inst;
-    unsigned char first = message->at(0);
-    unsigned char type = first >> 4;
-    //unsigned char channel = first & 0x0F;
-    switch(type)
+    if(!parse_midi_message(&message->at(0), message->size(), event))
     {
-        case 0x9: // Note down
-        {
-            unsigned char note = message->at(1);
-            float veloc = double(message->at(2))/100;
-            inst->on_note_down(note, veloc, time);
-            break;
-        }
-
-        case 0x8: // Note up
-        {
-            unsigned char note = message->at(1);
-            float veloc = double(message->at(2))/100;
-            inst->on_note_up(note, veloc, time);
-            break;
-        }
-
-        case 0xB: // Control message 
-        {
-            switch(message->at(1))
-            {
-                case 0x01: // modulation wheel
-                {
-                    float value = (float)message->at(2) / 127;
-                    inst->on_modulation_wheel(value, time);
-                    break;
-                }
-
-                case 0x40: // sustain pedal
-                {
-                    if(message->at(2) < 63)
-                        inst->on_sustain_up(time);
-                    else
-                        inst->on_sustain_down(time);
-
-                    break;
-                }
-
-                default:
-                    goto UNHANDLED;
-                    break;
-            }
-                
-            break;
-        }
-
-        case 0xE: // Pitch wheel
-        {
-            // Convert to float between -1.0 and 1.0
-            unsigned value = (message->at(2) << 7) | message->at(1);
-            int centered = value - 0x2000;
-            float bend = (float)centered / 0x2000;
-
-            inst->on_pitch_wheel(bend, time);
-            break;
-        }
-        
-        UNHANDLED:
-        default:
-        {
-            inst->on_midi_message(message, time);
-        }
+        std::cerr << "Ignoring malformed MIDI message." << std::endl;
+        return;
     }
+
+    if(!listener->inst->queue_event(event))
+        std::cerr << "MIDI event queue full, dropping message." << std::endl;
 }
 
 
 void MidiListener::timing_callback(unsigned long time, void* payload)
 {
     MidiListener* listener = (MidiListener*) payload;
-    listener->buffer_timestamp = chr::high_resolution_clock::now();
-    listener->next_buffer_time = time;
+    long long now = chr::duration_cast<chr::nanoseconds>(
+            chr::steady_clock::now().time_since_epoch()).count();
+
+    // Only the audio thread writes, so the sequence needs no compare and swap
+    unsigned sequence =
+        listener->timing_sequence.load(std::memory_order_relaxed);
+    listener->timing_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    listener->buffer_timestamp.store(now, std::memory_order_relaxed);
+    listener->next_buffer_time.store(time, std::memory_order_relaxed);
+    listener->timing_sequence.store(sequence + 2, std::memory_order_release);
 }
@@ -1,6 +1,7 @@
 #ifndef MIDI_WRAPPER_H
 #define MIDI_WRAPPER_H
 
+#include <atomic>
 #include <chrono>
 #include <rtmidi.h>
 #include "generic_instrument.h"
@@ -10,7 +11,13 @@ namespace ClickTrack
 {
     /* A wrapper for RtMIDI. It is registered directly to an instrument class
      * and handles all its playing through callbacks to the MIDI process. It
-     * internally talks to its instrument to convey state.
+     * parses each message into an event and queues it for the instrument,
+     * which applies it from the audio thread.
+     *
+     * Events are timestamped one buffer after the time they arrive, so they
+     * play with a fixed latency. This requires timing_callback to be
+     * registered with the speaker; otherwise, events play at the start of
+     * the next block.
      */
     class MidiListener
     {
@@ -44,11 +51,17 @@ namespace ClickTrack
             RtMidiIn stream;
             GenericInstrument* inst;
 
-            /* State for timing and computing buffer offsets
+            /* State for timing and computing buffer offsets. These are
+             * written by the audio thread and read by the MIDI thread. The
+             * timestamp is in nanoseconds of the steady clock.
+             *
+             * The pair is published under a sequence lock, so the reader never
+             * mixes the time of one buffer with the timestamp of another. The
+             * sequence is odd while the writer is part way through.
              */
-            std::chrono::time_point<std::chrono::high_resolution_clock,
-                std::chrono::duration<double> > buffer_timestamp;
-            unsigned long next_buffer_time;
+            std::atomic<unsigned> timing_sequence;
+            std::atomic<long long> buffer_timestamp;
+            std::atomic<unsigned long> next_buffer_time;
     };
 }
 
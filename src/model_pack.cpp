@@ -0,0 +1,254 @@
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "model_pack.h"
+
+using namespace ClickTrack;
+
+static const char pack_magic[8] = { 'C', 'T', 'V', 'O', 'X', 'P', 'K', 0 };
+static const uint32_t pack_byte_order = 0x01020304;
+
+
+/* Rounds a size up to a multiple of the given power of two
+ */
+static unsigned long round_up(unsigned long size, unsigned long multiple)
+{
+    return (size + multiple - 1) & ~(multiple - 1);
+}
+
+
+ModelPack::ModelPack(const std::string& path)
+    : mapping(NULL), mapping_size(0), header(NULL), entries(NULL),
+      coeffs(NULL)
+{
+    // Map the whole file
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw ModelPackInvalid("The model pack could not be opened.");
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(Header))
+    {
+        close(fd);
+        throw ModelPackInvalid("The model pack is too short.");
+    }
+
+    mapping_size = info.st_size;
+    mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        mapping = NULL;
+        throw ModelPackInvalid("The model pack could not be mapped.");
+    }
+
+    // Validate the header before trusting any of its offsets
+    const unsigned char* bytes = (const unsigned char*) mapping;
+    header = (const Header*) bytes;
+    const char* reason = NULL;
+    if(memcmp(header->magic, pack_magic, sizeof(pack_magic)) != 0)
+        reason = "The file is not a model pack.";
+    else if(header->byte_order != pack_byte_order)
+        reason = "The model pack was written with another byte order.";
+    else if(header->version != version)
+        reason = "The model pack has an unsupported version.";
+    else if(header->file_size != mapping_size)
+        reason = "The model pack is truncated.";
+    else if(header->coeffs_stride < header->num_coeffs ||
+            header->coeffs_offset % alignment != 0 ||
+            header->coeffs_offset < sizeof(Header) +
+                header->num_phonemes*sizeof(Entry) ||
+            header->num_records < header->num_phonemes ||
+            header->coeffs_offset + (unsigned long) header->num_records *
+                header->coeffs_stride*sizeof(float) > mapping_size)
+        reason = "The model pack layout is corrupt.";
+    else if(checksum(bytes + sizeof(Header), mapping_size - sizeof(Header)) 
+            != header->checksum)
+        reason = "The model pack failed its checksum.";
+
+    if(reason == NULL)
+    {
+        entries = (const Entry*) (bytes + sizeof(Header));
+        coeffs = (const float*) (bytes + header->coeffs_offset);
+
+        // Every phoneme must agree on the size of the lattice, and keep its
+        // trajectory within the pack
+        for(unsigned i = 0; i < header->num_phonemes; i++)
+        {
+            if(entries[i].num_coeffs != header->num_coeffs)
+                reason = "A model pack phoneme has the wrong coefficient count.";
+            else if(entries[i].num_frames > 0 &&
+                    (entries[i].first_frame < header->num_phonemes ||
+                     (unsigned long) entries[i].first_frame +
+                        entries[i].num_frames > header->num_records))
+                reason = "A model pack trajectory is out of range.";
+        }
+    }
+
+    if(reason != NULL)
+    {
+        munmap(mapping, mapping_size);
+        mapping = NULL;
+        throw ModelPackInvalid(reason);
+    }
+}
+
+
+ModelPack::~ModelPack()
+{
+    if(mapping != NULL)
+        munmap(mapping, mapping_size);
+}
+
+
+unsigned ModelPack::get_num_phonemes()
+{
+    return header->num_phonemes;
+}
+
+
+unsigned ModelPack::get_num_coeffs()
+{
+    return header->num_coeffs;
+}
+
+
+unsigned ModelPack::find(const std::string& name)
+{
+    for(unsigned i = 0; i < header->num_phonemes; i++)
+    {
+        if(get_name(i) == name)
+            return i;
+    }
+    return header->num_phonemes;
+}
+
+
+std::string ModelPack::get_name(unsigned phoneme)
+{
+    const char* name = entries[phoneme].name;
+    return std::string(name, strnlen(name, max_name_length));
+}
+
+
+float ModelPack::get_gain(unsigned phoneme)
+{
+    return entries[phoneme].gain;
+}
+
+
+const float* ModelPack::get_coeffs(unsigned phoneme)
+{
+    return coeffs + (unsigned long) phoneme*header->coeffs_stride;
+}
+
+
+unsigned ModelPack::get_num_frames(unsigned phoneme)
+{
+    return entries[phoneme].num_frames;
+}
+
+
+const float* ModelPack::get_frame(unsigned phoneme, unsigned frame)
+{
+    unsigned long record = entries[phoneme].first_frame + frame;
+    return coeffs + record*header->coeffs_stride;
+}
+
+
+void ModelPack::write(const std::string& path,
+        const std::vector<std::string>& names, const std::vector<float>& gains,
+        const std::vector< std::vector<float> >& all_coeffs,
+        const std::vector<Trajectory>& trajectories)
+{
+    if(names.size() != gains.size() || names.size() != all_coeffs.size() ||
+            (!trajectories.empty() && names.size() != trajectories.size()))
+        throw ModelPackInvalid("Every phoneme needs a name, gain and coeffs.");
+
+    unsigned num_coeffs = all_coeffs.empty() ? 0 : all_coeffs[0].size();
+    unsigned long num_records = names.size();
+    for(unsigned i = 0; i < names.size(); i++)
+    {
+        if(all_coeffs[i].size() != num_coeffs)
+            throw ModelPackInvalid(
+                    "Every phoneme must have the same number of coeffs.");
+        if(names[i].empty() || names[i].size() > max_name_length)
+            throw ModelPackInvalid("A phoneme name is empty or too long.");
+
+        for(unsigned f = 0; !trajectories.empty() &&
+                f < trajectories[i].size(); f++)
+        {
+            if(trajectories[i][f].size() != num_coeffs)
+                throw ModelPackInvalid(
+                        "Every phoneme must have the same number of coeffs.");
+            num_records++;
+        }
+    }
+
+    // Lay out the file
+    unsigned long stride = round_up(num_coeffs, alignment/sizeof(float));
+    unsigned long offset = round_up(sizeof(Header) + names.size()*sizeof(Entry),
+            alignment);
+    unsigned long size = offset + num_records*stride*sizeof(float);
+    std::vector<unsigned char> bytes(size, 0);
+
+    // Each phoneme's record, then the frames of each trajectory in turn
+    Entry* entries = (Entry*) &bytes[sizeof(Header)];
+    float* coeffs = (float*) &bytes[offset];
+    unsigned long record = names.size();
+    for(unsigned i = 0; i < names.size(); i++)
+    {
+        memcpy(entries[i].name, names[i].data(), names[i].size());
+        entries[i].gain = gains[i];
+        entries[i].num_coeffs = num_coeffs;
+        for(unsigned j = 0; j < num_coeffs; j++)
+            coeffs[i*stride + j] = all_coeffs[i][j];
+
+        entries[i].num_frames = 0;
+        entries[i].first_frame = 0;
+        if(trajectories.empty() || trajectories[i].empty())
+            continue;
+
+        entries[i].num_frames = trajectories[i].size();
+        entries[i].first_frame = record;
+        for(unsigned f = 0; f < trajectories[i].size(); f++, record++)
+        {
+            for(unsigned j = 0; j < num_coeffs; j++)
+                coeffs[record*stride + j] = trajectories[i][f][j];
+        }
+    }
+
+    Header* header = (Header*) &bytes[0];
+    memcpy(header->magic, pack_magic, sizeof(pack_magic));
+    header->version = version;
+    header->byte_order = pack_byte_order;
+    header->num_phonemes = names.size();
+    header->num_coeffs = num_coeffs;
+    header->coeffs_stride = stride;
+    header->coeffs_offset = offset;
+    header->file_size = size;
+    header->num_records = num_records;
+    header->checksum = checksum(&bytes[sizeof(Header)], size - sizeof(Header));
+
+    // Write it out
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write((const char*) &bytes[0], size);
+    if(!file)
+        throw ModelPackInvalid("The model pack could not be written.");
+}
+
+
+uint32_t ModelPack::checksum(const unsigned char* data, unsigned long size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for(unsigned long i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for(unsigned bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
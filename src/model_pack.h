@@ -0,0 +1,142 @@
+#ifndef MODEL_PACK_H
+#define MODEL_PACK_H
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* A model pack holds the trained gain and reflection coefficients of
+     * every phoneme in one binary file. A phoneme may also hold a trajectory:
+     * a short series of frames of coefficients through which it moves over
+     * time, such as the burst of a stop. The file is memory mapped, so loading
+     * it costs the same however many phonemes it holds, and the coefficients
+     * are read straight out of the mapping.
+     *
+     * The file is laid out as:
+     *
+     *     header     magic, version, counts, offsets and a checksum
+     *     entries    one per phoneme: name, gain, coefficient count and
+     *                the extent of its trajectory
+     *     coeffs     one record per phoneme, followed by one per frame of
+     *                every trajectory, each starting on a 64 byte boundary
+     *                and padded to a multiple of 16 floats
+     *
+     * Frames are sampled every few milliseconds, and are stretched over the
+     * sound as it plays, so a trajectory takes only a few records.
+     *
+     * Values are stored in the byte order of the machine that wrote them,
+     * and the checksum is a CRC-32 of everything after the header.
+     */
+    class ModelPack
+    {
+        public:
+            /* Maps the pack at the given path. Throws ModelPackInvalid if the
+             * file cannot be read, is not a pack of this version, is
+             * truncated, fails its checksum, or has a phoneme whose
+             * coefficient count differs from the rest or whose trajectory
+             * lies outside the pack.
+             */
+            ModelPack(const std::string& path);
+            ~ModelPack();
+
+            unsigned get_num_phonemes();
+            unsigned get_num_coeffs();
+
+            /* Finds a phoneme by name. Returns get_num_phonemes() if it is not
+             * in the pack.
+             */
+            unsigned find(const std::string& name);
+
+            /* Access the data of the phoneme at the given index. The
+             * coefficients are valid for the lifetime of the pack.
+             */
+            std::string get_name(unsigned phoneme);
+            float get_gain(unsigned phoneme);
+            const float* get_coeffs(unsigned phoneme);
+
+            /* Access the trajectory of a phoneme, which has no frames if it
+             * holds only its one set of coefficients
+             */
+            unsigned get_num_frames(unsigned phoneme);
+            const float* get_frame(unsigned phoneme, unsigned frame);
+
+            /* Writes a pack to the given path. Each phoneme has a list of
+             * trajectory frames, which may be empty, and if none have any
+             * the list may be left out. Every phoneme and frame must have
+             * the same number of coefficients, or ModelPackInvalid is
+             * thrown.
+             */
+            typedef std::vector< std::vector<float> > Trajectory;
+            static void write(const std::string& path,
+                    const std::vector<std::string>& names,
+                    const std::vector<float>& gains,
+                    const std::vector< std::vector<float> >& coeffs,
+                    const std::vector<Trajectory>& trajectories =
+                        std::vector<Trajectory>());
+
+            /* The on disk structures
+             */
+            static const unsigned version = 2;
+            static const unsigned alignment = 64;
+            static const unsigned max_name_length = 8;
+            struct Header
+            {
+                char magic[8];
+                uint32_t version;
+                uint32_t byte_order;
+                uint32_t num_phonemes;
+                uint32_t num_coeffs;
+                uint32_t coeffs_stride; // floats between records
+                uint32_t coeffs_offset; // bytes from the start of the file
+                uint64_t file_size;
+                uint32_t checksum;
+                uint32_t num_records; // phonemes and trajectory frames
+                uint32_t reserved[4];
+            };
+            struct Entry
+            {
+                char name[max_name_length];
+                float gain;
+                uint32_t num_coeffs;
+                uint32_t num_frames;
+                uint32_t first_frame; // record of the first frame
+            };
+
+        private:
+            /* Computes the CRC-32 of a range of bytes
+             */
+            static uint32_t checksum(const unsigned char* data,
+                    unsigned long size);
+
+            /* The mapping, and pointers into it
+             */
+            void* mapping;
+            unsigned long mapping_size;
+
+            const Header* header;
+            const Entry* entries;
+            const float* coeffs;
+    };
+
+
+    /* Exception thrown when a pack cannot be loaded or written
+     */
+    class ModelPackInvalid: public std::exception
+    {
+        public:
+            ModelPackInvalid(const char* in_reason)
+                : reason(in_reason) {}
+
+            const char* reason;
+            virtual const char* what() const throw()
+            {
+                return reason;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <atomic>
+#include "noise.h"
+
+using namespace ClickTrack;
+
+
+/* Scrambles a seed into a well mixed 32 bit value, using the finalizer of
+ * splitmix64. Nearby seeds give unrelated streams.
+ */
+static uint32_t mix_seed(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return (x ^ (x >> 31)) & 0xFFFFFFFF;
+}
+
+
+NoiseGenerator::NoiseGenerator()
+{
+    static std::atomic<uint32_t> next_seed(1);
+    seed(next_seed.fetch_add(1, std::memory_order_relaxed));
+}
+
+
+NoiseGenerator::NoiseGenerator(uint32_t in_seed)
+{
+    seed(in_seed);
+}
+
+
+void NoiseGenerator::seed(uint32_t in_seed)
+{
+    // Xorshift must never be given a zero state
+    for(unsigned l = 0; l < lanes; l++)
+    {
+        state[l] = mix_seed(((uint64_t) in_seed << 2) | l);
+        if(state[l] == 0)
+            state[l] = 0x6D2B79F5;
+    }
+
+    for(unsigned i = 0; i < 7; i++)
+        pink[i] = 0.0;
+    brown = 0.0;
+}
+
+
+void NoiseGenerator::fill_white(SAMPLE* output, unsigned n)
+{
+    // Map the signed 32 bit range to [-1, 1)
+    const float scale = 1.0f / 2147483648.0f;
+
+    uint32_t s[lanes];
+    for(unsigned l = 0; l < lanes; l++)
+        s[l] = state[l];
+
+    unsigned i = 0;
+    for(; i + lanes <= n; i += lanes)
+    {
+        for(unsigned l = 0; l < lanes; l++)
+        {
+            uint32_t x = s[l];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            s[l] = x;
+            output[i + l] = (int32_t) x * scale;
+        }
+    }
+
+    // Whatever is left uses the first few lanes
+    for(unsigned l = 0; i < n; i++, l++)
+    {
+        uint32_t x = s[l];
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        s[l] = x;
+        output[i] = (int32_t) x * scale;
+    }
+
+    for(unsigned l = 0; l < lanes; l++)
+        state[l] = s[l];
+}
+
+
+void NoiseGenerator::fill_pink(SAMPLE* output, unsigned n)
+{
+    fill_white(output, n);
+
+    // Seven first order filters, spread to approximate a 1/f slope
+    float b0 = pink[0], b1 = pink[1], b2 = pink[2], b3 = pink[3],
+          b4 = pink[4], b5 = pink[5], b6 = pink[6];
+    for(unsigned i = 0; i < n; i++)
+    {
+        float white = output[i];
+        b0 = 0.99886f*b0 + white*0.0555179f;
+        b1 = 0.99332f*b1 + white*0.0750759f;
+        b2 = 0.96900f*b2 + white*0.1538520f;
+        b3 = 0.86650f*b3 + white*0.3104856f;
+        b4 = 0.55000f*b4 + white*0.5329522f;
+        b5 = -0.7616f*b5 - white*0.0168980f;
+        output[i] = (b0 + b1 + b2 + b3 + b4 + b5 + b6 + white*0.5362f) *
+            0.11f;
+        b6 = white*0.115926f;
+    }
+
+    pink[0] = b0; pink[1] = b1; pink[2] = b2; pink[3] = b3;
+    pink[4] = b4; pink[5] = b5; pink[6] = b6;
+}
+
+
+void NoiseGenerator::fill_brown(SAMPLE* output, unsigned n)
+{
+    fill_white(output, n);
+
+    // Integrate, leaking slowly back to zero so the output cannot drift
+    float b = brown;
+    for(unsigned i = 0; i < n; i++)
+    {
+        b = (b + 0.02f*output[i]) / 1.02f;
+        output[i] = b * 3.5f;
+    }
+    brown = b;
+}
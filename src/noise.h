@@ -0,0 +1,50 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstdint>
+#include "portaudio_wrapper.h"
+
+
+namespace ClickTrack
+{
+    /* A fast noise generator for use on the audio thread. Each instance has
+     * its own state, so generators never contend with each other and can be
+     * seeded to produce different, repeatable sequences.
+     *
+     * It runs four xorshift generators side by side, one per output sample
+     * in each group of four, so that the compiler can fill whole blocks with
+     * SIMD instructions.
+     *
+     * White noise is uniform in [-1, 1). Pink noise falls at 3 dB per octave,
+     * using Paul Kellet's filter, and brown noise at 6 dB per octave, using
+     * a leaky integrator. Both are scaled to peak just under one, so they
+     * are about 10 dB quieter than the white noise.
+     */
+    class NoiseGenerator
+    {
+        public:
+            /* Without a seed, each generator is given a different one
+             */
+            NoiseGenerator();
+            NoiseGenerator(uint32_t seed);
+
+            void seed(uint32_t seed);
+
+            /* Fills n samples with noise
+             */
+            void fill_white(SAMPLE* output, unsigned n);
+            void fill_pink(SAMPLE* output, unsigned n);
+            void fill_brown(SAMPLE* output, unsigned n);
+
+        private:
+            static const unsigned lanes = 4;
+            uint32_t state[lanes];
+
+            /* Filter state for coloured noise
+             */
+            float pink[7];
+            float brown;
+    };
+}
+
+#endif
@@ -1,6 +1,7 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <random>
+#include "fast_math.h"
 #include "oscillator.h"
 #include "portaudio_wrapper.h"
 
@@ -9,13 +10,28 @@ using namespace ClickTrack;
 Oscillator::Oscillator(Mode in_mode, float in_freq)
     : AudioGenerator(1), last_output(0.0), scheduler(*this), lfo(nullptr),
       lfo_intensity(0.0), phase(0.0), phase_inc(in_freq * 2*M_PI/SAMPLE_RATE), 
-      transpose(1.0), mode(in_mode), freq(in_freq)
-{}
+      transpose(1.0), glide_inc(0.0), glide_target(0.0), glide_remaining(0),
+      mode(in_mode), table(NULL), noise(), freq(in_freq),
+      lfo_block(BUFFER_SIZE), phases(BUFFER_SIZE)
+{
+    set_mode(in_mode);
+}
 
 
 void Oscillator::set_mode(Mode in_mode)
 {
     mode = in_mode;
+
+    // Looking up the table builds it on first use, so do it here rather
+    // than while rendering
+    switch(mode)
+    {
+        case TableSine:   table = &Wavetable::get(Wavetable::Sine); break;
+        case TableSaw:    table = &Wavetable::get(Wavetable::Saw); break;
+        case TableSquare: table = &Wavetable::get(Wavetable::Square); break;
+        case TableTri:    table = &Wavetable::get(Wavetable::Tri); break;
+        default:          table = NULL; break;
+    }
 }
 
 
@@ -24,10 +40,20 @@ void Oscillator::set_freq(float in_freq, unsigned long time)
     if(time == 0)
         time = get_next_time();
 
-    // Put the frequency in the payload and schedule the call
-    float* payload = new float;
-    *payload = in_freq;
-    scheduler.schedule(time, Oscillator::set_freq_callback, payload);
+    // The frequency is carried by the event itself
+    FreqChange change = {in_freq, 0};
+    scheduler.schedule(time, Oscillator::set_freq_callback, change);
+}
+
+
+void Oscillator::glide_freq(float in_freq, unsigned duration,
+        unsigned long time)
+{
+    if(time == 0)
+        time = get_next_time();
+
+    FreqChange change = {in_freq, duration};
+    scheduler.schedule(time, Oscillator::set_freq_callback, change);
 }
 
 
@@ -49,115 +75,257 @@ void Oscillator::set_lfo_intensity(float steps)
 }
 
 
-void Oscillator::set_freq_callback(Oscillator& caller, void* payload)
+void Oscillator::set_seed(uint32_t seed)
 {
-    // Get the payload
-    float* in_freq = (float*) payload;
+    noise.seed(seed);
+}
 
-    // Tracks the current phase to maintain phase during 
-    caller.freq = *in_freq;
-    caller.phase_inc = caller.freq * 2*M_PI/SAMPLE_RATE;
 
-    // Release it
-    delete in_freq;
+void Oscillator::set_freq_callback(Oscillator& caller, FreqChange change)
+{
+    // Tracks the current phase to maintain phase during 
+    const float target = change.freq * 2*M_PI/SAMPLE_RATE;
+    if(change.glide == 0)
+    {
+        caller.freq = change.freq;
+        caller.phase_inc = target;
+        caller.glide_remaining = 0;
+    }
+    else
+    {
+        // Start from wherever a previous glide had got to
+        caller.glide_inc = (target - caller.phase_inc) / change.glide;
+        caller.glide_target = target;
+        caller.glide_remaining = change.glide;
+    }
 }
 
 
 void Oscillator::generate_outputs(std::vector<SAMPLE>& outputs, unsigned long t)
 {
-    // Run event changes
-    scheduler.run(t);
+    SAMPLE lfo_sample;
+    const SAMPLE* lfo_samples = NULL;
+    if(lfo != nullptr)
+    {
+        lfo_sample = lfo->get_sample(t);
+        lfo_samples = &lfo_sample;
+    }
+
+    render(&outputs[0], 1, t, lfo_samples);
+}
+
+
+void Oscillator::generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+        unsigned long t)
+{
+    // Read the whole LFO block at once
+    const SAMPLE* lfo_samples = NULL;
+    if(lfo != nullptr)
+    {
+        lfo->get_block(lfo_block, t);
+        lfo_samples = &lfo_block[0];
+    }
+
+    render(&outputs[0][0], BUFFER_SIZE, t, lfo_samples);
+}
 
-    // Compute the LFO contribution
-    float lfo_transpose = 1.0;
+
+void Oscillator::render(SAMPLE* output, unsigned n, unsigned long t,
+        const SAMPLE* lfo_samples)
+{
+    unsigned start = 0;
+    while(start < n)
+    {
+        // Run event changes
+        scheduler.run(t+start);
+
+        // Render in one pass up to the next event
+        unsigned end = n;
+        unsigned long event_time;
+        if(scheduler.next_event_time(event_time) && event_time < t+n)
+            end = event_time - t;
+        if(end - start > BUFFER_SIZE)
+            end = start + BUFFER_SIZE;
+
+        render_span(output + start, end - start,
+                lfo_samples == NULL ? NULL : lfo_samples + start);
+        start = end;
+    }
+}
+
+
+void Oscillator::get_dependencies(std::vector<Channel*>& channels)
+{
     if(lfo != nullptr)
-        lfo_transpose = pow(2, lfo->get_sample(t) * lfo_intensity);
+        channels.push_back(lfo);
+}
 
+
+void Oscillator::render_span(SAMPLE* output, unsigned n,
+        const SAMPLE* lfo_samples)
+{
     // Update the phase
-    phase += phase_inc * transpose * lfo_transpose;
-    if(phase >= 2*M_PI) phase -= 2*M_PI;
+    float step = phase_inc * transpose;
+    if(lfo_samples != NULL)
+    {
+        // Compute the LFO contribution at control rate
+        control_rate_exp2(lfo_samples, lfo_intensity, &phases[0], n);
+    }
+    if(glide_remaining > 0)
+    {
+        // Ramp the increment through the glide, a sample at a time
+        const unsigned ramp = std::min(n, glide_remaining);
+        for(unsigned i = 0; i < n; i++)
+        {
+            if(i < ramp)
+                phase_inc += glide_inc;
+            float s = phase_inc * transpose;
+            if(lfo_samples != NULL)
+                s *= phases[i];
+            phase += s;
+            if(phase >= 2*M_PI) phase -= 2*M_PI;
+            phases[i] = phase;
+        }
 
-    // Generate this output
-    SAMPLE out;
+        // Land exactly on the target, and keep the widest step for the
+        // table level below
+        glide_remaining -= ramp;
+        if(glide_remaining == 0)
+            phase_inc = glide_target;
+        freq = phase_inc * SAMPLE_RATE/(2*M_PI);
+        step = std::max(step, phase_inc * transpose);
+    }
+    else if(lfo_samples != NULL)
+    {
+        for(unsigned i = 0; i < n; i++)
+        {
+            phase += step * phases[i];
+            if(phase >= 2*M_PI) phase -= 2*M_PI;
+            phases[i] = phase;
+        }
+    }
+    else
+    {
+        for(unsigned i = 0; i < n; i++)
+        {
+            phase += step;
+            if(phase >= 2*M_PI) phase -= 2*M_PI;
+            phases[i] = phase;
+        }
+    }
+
+    // Generate the outputs
     switch(mode)
     {
         case Sine:
         {
-            out = sin(phase);
+            for(unsigned i = 0; i < n; i++)
+            {
+                float p = phases[i];
+                output[i] = sin(p);
+            }
             break;
         }
 
         case Saw:
-        case BlepSaw:
         {
-            out = 2.0*phase/(2*M_PI) - 1.0;
+            for(unsigned i = 0; i < n; i++)
+                output[i] = 2.0*phases[i]/(2*M_PI) - 1.0;
+            break;
+        }
 
+        case BlepSaw:
+        {
             // one discontinuity, at edge of saw
-            if(mode == BlepSaw)
-                out -= polyBlepOffset(phase/(2*M_PI));
-
+            for(unsigned i = 0; i < n; i++)
+            {
+                SAMPLE out = 2.0*phases[i]/(2*M_PI) - 1.0;
+                out -= polyBlepOffset(phases[i]/(2*M_PI));
+                output[i] = out;
+            }
             break;
         }
 
         case Square:
-        case BlepSquare:
         {
-            if(phase < M_PI)
-                out = 1.0;
-            else
-                out = -1.0;
+            for(unsigned i = 0; i < n; i++)
+                output[i] = phases[i] < M_PI ? 1.0 : -1.0;
+            break;
+        }
 
+        case BlepSquare:
+        {
             // two discontinuities, at rising and falling edge
-            if(mode == BlepSquare)
+            for(unsigned i = 0; i < n; i++)
             {
-                out += polyBlepOffset(phase/(2*M_PI));
-                out -= polyBlepOffset(fmod(phase/(2*M_PI) + 0.5, 1.0));
+                SAMPLE out = phases[i] < M_PI ? 1.0 : -1.0;
+                out += polyBlepOffset(phases[i]/(2*M_PI));
+                out -= polyBlepOffset(fmod(phases[i]/(2*M_PI) + 0.5, 1.0));
+                output[i] = out;
             }
-
             break;
         }
 
         case Tri:
         case BlepTri:
         {
-            // Compute a square wave signal
-            if(phase < M_PI)
-                out = 1.0;
-            else
-                out = -1.0;
-
-            // two discontinuities, at rising and falling edge
-            if(mode == BlepTri)
+            for(unsigned i = 0; i < n; i++)
             {
-                out += polyBlepOffset(phase/(2*M_PI));
-                out -= polyBlepOffset(fmod(phase/(2*M_PI) + 0.5, 1.0));
+                // Compute a square wave signal
+                SAMPLE out = phases[i] < M_PI ? 1.0 : -1.0;
+
+                // two discontinuities, at rising and falling edge
+                if(mode == BlepTri)
+                {
+                    out += polyBlepOffset(phases[i]/(2*M_PI));
+                    out -= polyBlepOffset(fmod(phases[i]/(2*M_PI) + 0.5, 1.0));
+                }
+
+                // Perform leaky integration of a square wave
+                out = phase_inc*out + (1-phase_inc)*last_output;
+                last_output = out;
+                output[i] = out;
             }
-
-            // Perform leaky integration of a square wave
-            out = phase_inc*out + (1-phase_inc)*last_output;
-            last_output = out;
             break;
         }
 
         case WhiteNoise:
-        {
-            int si = rand();
-            float sf = ((float) si) / RAND_MAX;
-            out = 2*sf - 1;
+            noise.fill_white(output, n);
+            break;
+
+        case PinkNoise:
+            noise.fill_pink(output, n);
+            break;
+
+        case BrownNoise:
+            noise.fill_brown(output, n);
             break;
-        }
 
         case PulseTrain:
         {
             // If we wrapped around...
-            if(phase < phase_inc)
-                out = 1.0;
-            else
-                out = 0.0;
+            for(unsigned i = 0; i < n; i++)
+                output[i] = phases[i] < phase_inc ? 1.0 : 0.0;
+            break;
+        }
+
+        case TableSine:
+        case TableSaw:
+        case TableSquare:
+        case TableTri:
+        {
+            // Choose one level for the whole span, leaving room for the LFO
+            // to raise the pitch
+            float max_step = step;
+            if(lfo_samples != NULL)
+                max_step *= fast_exp2(fabs(lfo_intensity));
+            unsigned level = table->get_level(max_step);
+
+            for(unsigned i = 0; i < n; i++)
+                output[i] = table->lookup(level, phases[i]);
             break;
         }
     }
-    outputs[0] = out;
 }
 
 
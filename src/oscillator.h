@@ -2,7 +2,9 @@
 #define OSCILLATOR_H
 
 #include "audio_generics.h"
+#include "noise.h"
 #include "scheduler.h"
+#include "wavetable.h"
 
 
 namespace ClickTrack
@@ -12,14 +14,18 @@ namespace ClickTrack
      */
     class Oscillator : public AudioGenerator
     {
-        friend class FunctionScheduler<Oscillator>;
-
         public:
             /* The oscillator supports many waveform modes.
              * Blep oscillators use PolyBlep to generate alias-free waveforms
+             * Table oscillators read band limited wavetables shared by all
+             * oscillators, picking the level of detail from the pitch
+             * Noise modes ignore the frequency, and each oscillator has its
+             * own noise sequence
              */
             enum Mode { Sine, Saw, Square, Tri, WhiteNoise, 
-                BlepSaw, BlepSquare, BlepTri, PulseTrain};
+                BlepSaw, BlepSquare, BlepTri, PulseTrain,
+                TableSine, TableSaw, TableSquare, TableTri,
+                PinkNoise, BrownNoise};
             Oscillator(Mode mode, float in_freq);
 
             /* Sets the waveform mode
@@ -32,6 +38,14 @@ namespace ClickTrack
              */
             void set_freq(float freq, unsigned long time=0);
 
+            /* Slides the frequency linearly from wherever it is at the given
+             * time to freq over duration samples. The slide is rendered inside
+             * the oscillator, so it costs one scheduled event rather than one
+             * per sample. A later set_freq cancels it
+             */
+            void glide_freq(float freq, unsigned duration,
+                    unsigned long time=0);
+
             /* Given an increment in steps, transposes the output frequency of
              * the osciilator by that many steps
              */
@@ -44,10 +58,33 @@ namespace ClickTrack
             void set_lfo_input(Channel* input);
             void set_lfo_intensity(float steps);
 
+            /* Reseeds the noise modes, to repeat a noise sequence
+             */
+            void set_seed(uint32_t seed);
+
+            /* Renders n samples beginning at time t straight into a buffer,
+             * bypassing the output channel. This lets an owner drive the
+             * oscillator from within its own block, in pieces of any size.
+             * The LFO input is read from lfo_samples instead of the LFO
+             * channel, and is skipped if it is NULL.
+             */
+            void render(SAMPLE* output, unsigned n, unsigned long t,
+                    const SAMPLE* lfo_samples);
+
         protected:
+            /* A frequency change, applied over glide samples
+             */
+            struct FreqChange
+            {
+                float freq;
+                unsigned glide;
+            };
+            friend class FunctionScheduler<Oscillator, FreqChange>;
+
             /* This callback can only be set by the scheduler
              */
-            static void set_freq_callback(Oscillator& caller, void* payload);
+            static void set_freq_callback(Oscillator& caller,
+                    FreqChange change);
 
         private: 
             /* Overridden method for AudioGenerator to provide basic time
@@ -56,12 +93,25 @@ namespace ClickTrack
              * PolyBLEP oscillators use a periodic offset to remove aliasing
              */
             void generate_outputs(std::vector<SAMPLE>& outputs, unsigned long t);
+            void generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+                    unsigned long t);
+
+            /* The oscillator depends on its LFO, if one is set
+             */
+            void get_dependencies(std::vector<Channel*>& channels);
+
+            /* Renders a span of samples with no scheduled events inside it.
+             * The phase is advanced for the whole span first, then the
+             * waveform is computed in a separate loop for each mode.
+             */
+            void render_span(SAMPLE* output, unsigned n,
+                    const SAMPLE* lfo_samples);
             float polyBlepOffset(float t);
             float last_output; // used by blep triangle
 
             /* Used to schedule frequency changes
              */
-            FunctionScheduler<Oscillator> scheduler;
+            FunctionScheduler<Oscillator, FreqChange> scheduler;
 
             /* LFO input
              */
@@ -74,10 +124,24 @@ namespace ClickTrack
             float phase_inc; // rads
             float transpose;
 
-            /* Oscillator state
+            /* Glide state: the phase increment moves by glide_inc each sample
+             * until glide_remaining runs out, then lands on glide_target
+             */
+            float glide_inc;    // rads
+            float glide_target; // rads
+            unsigned glide_remaining;
+
+            /* Oscillator state. The table is only set in table modes
              */
             Mode mode;
+            const Wavetable* table;
+            NoiseGenerator noise;
             float freq; // hz
+
+            /* Statically allocated LFO and phase blocks for speed
+             */
+            std::vector<SAMPLE> lfo_block;
+            std::vector<float> phases;
     };
 }
 
@@ -1,4 +1,7 @@
+#include <chrono>
 #include <iostream>
+#include <thread>
+#include "dsp_load.h"
 #include "portaudio_wrapper.h"
 
 using namespace ClickTrack;
@@ -107,8 +110,11 @@ void InputStream::readFromStream(std::vector< std::vector<SAMPLE> >& out)
 
 
 
-OutputStream::OutputStream(unsigned in_channels, bool useDefault)
-    : channels(in_channels)
+OutputStream::OutputStream(unsigned in_channels, bool useDefault,
+        unsigned in_render_ahead)
+    : channels(in_channels), render_ahead(in_render_ahead),
+      ring(in_render_ahead*BUFFER_SIZE*in_channels), primed(false),
+      underruns(0), latency(0.0)
 {
     // Initialize portaudio
     pa_error_check("PaInitialize", Pa_Initialize());
@@ -161,14 +167,18 @@ OutputStream::OutputStream(unsigned in_channels, bool useDefault)
     outputParams.hostApiSpecificStreamInfo = NULL;
 
     //Open the stream!
+    PaStreamCallback* callback = NULL;
+    if(render_ahead > 0)
+        callback = &OutputStream::stream_callback;
     pa_error_check("Pa_OpenStream",
         Pa_OpenStream(&stream, NULL, &outputParams,
             SAMPLE_RATE, BUFFER_SIZE, paNoFlag,
-            NULL, NULL));
-    pa_error_check("Pa_StartStream", Pa_StartStream(stream));
+            callback, this));
 
     // Initialize buffer for writing
     buffer = new SAMPLE[channels*BUFFER_SIZE];
+
+    pa_error_check("Pa_StartStream", Pa_StartStream(stream));
 }
 
 
@@ -198,6 +208,66 @@ void OutputStream::writeToStream(std::vector< std::vector<SAMPLE> >& in)
         }
     }
 
+    // Time spent blocked on the stream is not part of the DSP load
+    CLICKTRACK_IDLE_SCOPE();
+
     // Write out to the stream
-    Pa_WriteStream(stream, buffer, BUFFER_SIZE);
+    if(render_ahead == 0)
+    {
+        Pa_WriteStream(stream, buffer, BUFFER_SIZE);
+        return;
+    }
+
+    // Wait for the ring to have room for another buffer
+    const unsigned buffer_samples = channels*BUFFER_SIZE;
+    while(ring.size() + buffer_samples > render_ahead*buffer_samples)
+    {
+        primed.store(true, std::memory_order_relaxed);
+        std::this_thread::sleep_for(std::chrono::microseconds(
+                    1000000 * BUFFER_SIZE / SAMPLE_RATE / 4));
+    }
+
+    ring.push(buffer, buffer_samples);
+}
+
+
+unsigned long OutputStream::get_underruns()
+{
+    return underruns.load(std::memory_order_relaxed);
+}
+
+
+double OutputStream::get_latency()
+{
+    return latency.load(std::memory_order_relaxed);
+}
+
+
+int OutputStream::stream_callback(const void* input, void* output,
+        unsigned long frames, const PaStreamCallbackTimeInfo* time,
+        PaStreamCallbackFlags flags, void* payload)
+{
+    OutputStream* out = (OutputStream*) payload;
+    SAMPLE* samples = (SAMPLE*) output;
+
+    // Drain the ring, padding with silence if it runs short
+    unsigned long wanted = frames*out->channels;
+    unsigned long i = out->ring.pop(samples, wanted);
+    for(unsigned long j = i; j < wanted; j++)
+        samples[j] = SAMPLE_SILENCE;
+
+    if(out->primed.load(std::memory_order_relaxed) &&
+            (i < wanted || (flags & paOutputUnderflow)))
+        out->underruns.fetch_add(1, std::memory_order_relaxed);
+
+    // The newest sample in the ring plays after everything queued ahead of
+    // it, plus the device's own delay
+    double device = time->outputBufferDacTime - time->currentTime;
+    if(device < 0.0)
+        device = 0.0;
+    double queued = (double) out->ring.size() / out->channels + frames;
+    out->latency.store(device + queued / SAMPLE_RATE,
+            std::memory_order_relaxed);
+
+    return paContinue;
 }
@@ -1,8 +1,10 @@
 #ifndef PORTAUDIO_WRAPPER_H
 #define PORTAUDIO_WRAPPER_H
 
+#include <atomic>
 #include <portaudio.h>
 #include <vector>
+#include "spsc_queue.h"
 
 
 /* Define the constants for portaudio library.
@@ -19,11 +21,24 @@ namespace ClickTrack
 {
     /* Define some key constants that can be used throughout the program.
      *
-     * Currently, a buffer size of 128 is the lowest power of two that will run
-     * skipfree on my laptop.
+     * With blocking output, a buffer size of 128 is the lowest power of two
+     * that will run skipfree on my laptop. Callback output with some render
+     * ahead absorbs hiccups in the render, so smaller buffers can be used
+     * there. The buffer size may be set at build time.
      */
+#ifndef CLICKTRACK_BUFFER_SIZE
+#define CLICKTRACK_BUFFER_SIZE 256
+#endif
     const unsigned SAMPLE_RATE = 44100; //hz
-    const unsigned BUFFER_SIZE = 256;
+    const unsigned BUFFER_SIZE = CLICKTRACK_BUFFER_SIZE;
+
+    /* Modulation, such as from an LFO, is evaluated once every control
+     * interval and interpolated in between. It may also be set at build time.
+     */
+#ifndef CLICKTRACK_CONTROL_INTERVAL
+#define CLICKTRACK_CONTROL_INTERVAL 16
+#endif
+    const unsigned CONTROL_INTERVAL = CLICKTRACK_CONTROL_INTERVAL;
 
 
     /* A wrapper for the portaudio boilerplate code. Should initialize and close
@@ -54,6 +69,12 @@ namespace ClickTrack
 
     /* A wrapper for the portaudio boilerplate code. Should initialize and close
      * the streams for us, and provide the ability to write to the audio stream.
+     *
+     * By default, writes block on the device. Given a render ahead depth, the
+     * stream runs in callback mode instead. Writes are queued in a lock free
+     * ring of up to that many buffers, and portaudio's callback drains it
+     * from its own thread. The thread that renders and writes then only
+     * waits while the ring is full, so it can get ahead of the device.
      */
     class OutputStream {
         public:
@@ -63,7 +84,8 @@ namespace ClickTrack
              *
              * If useDefault is false, then a chooser is presented to the user
              */
-            OutputStream(unsigned in_channels = 1, bool useDefault=true);
+            OutputStream(unsigned in_channels = 1, bool useDefault=true,
+                    unsigned in_render_ahead=0);
             ~OutputStream();
 
             /* Given a reference to a vector of channel data, writes the data to
@@ -71,10 +93,34 @@ namespace ClickTrack
              */
             void writeToStream(std::vector< std::vector<SAMPLE> >& in);
 
+            /* Statistics for callback mode. Underruns counts the callbacks
+             * which found the ring short of a full buffer. The latency is
+             * the time in seconds from a buffer being written until it
+             * reaches the DAC, as measured by the last callback.
+             */
+            unsigned long get_underruns();
+            double get_latency();
+
         private:
+            /* Portaudio callback for callback mode. The payload is the
+             * stream.
+             */
+            static int stream_callback(const void* input, void* output,
+                    unsigned long frames, const PaStreamCallbackTimeInfo* time,
+                    PaStreamCallbackFlags flags, void* payload);
+
             PaStream* stream;
             const unsigned channels;
             SAMPLE* buffer;
+
+            /* State for callback mode. Nothing is counted as an underrun
+             * until the ring has first been filled.
+             */
+            const unsigned render_ahead;
+            SpscQueue<SAMPLE> ring;
+            std::atomic<bool> primed;
+            std::atomic<unsigned long> underruns;
+            std::atomic<double> latency;
     };
 }
 
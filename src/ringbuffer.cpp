@@ -1,6 +1,7 @@
 #ifndef RINGBUFFER_CPP
 #define RINGBUFFER_CPP
 
+#include <algorithm>
 #include "ringbuffer.h"
 
 using namespace ClickTrack;
@@ -8,23 +9,25 @@ using namespace ClickTrack;
 
 template <class SampleT>
 RingBuffer<SampleT>::RingBuffer(unsigned n_buffer_size)
-    : samples(n_buffer_size)
+    : samples()
 {
     start_t = 0;
     end_t = 0;
-    size = 0;
 
-    buffer_size = n_buffer_size;
+    // Round up to a power of two so times can wrap with a mask
+    buffer_size = 1;
+    while(buffer_size < n_buffer_size)
+        buffer_size *= 2;
+    mask = buffer_size - 1;
+    samples.resize(buffer_size);
 }
 
 
 template <class SampleT>
 SampleT& RingBuffer<SampleT>::operator[] (unsigned long t)
 {
-    if(t < start_t || t >= end_t)
-        throw RingBufferOutOfRange(start_t, end_t, t);
-
-    return samples[t % buffer_size];                
+    check_range(t, t+1);
+    return samples[t & mask];
 }
 template <class SampleT>
 SampleT RingBuffer<SampleT>::get(const unsigned long t)
@@ -37,29 +40,95 @@ template <class SampleT>
 void RingBuffer<SampleT>::get_range(std::vector<SampleT>& buffer,
         const unsigned long start, const unsigned long end)
 {
-    for(int i = 0; i < end-start; i++)
-        buffer[i] = get(i+start);
+    Span first, second;
+    get_spans(start, end, first, second);
+    std::copy(first.data, first.data + first.size, buffer.begin());
+    std::copy(second.data, second.data + second.size,
+            buffer.begin() + first.size);
 }
 
 
 template <class SampleT>
-unsigned long RingBuffer<SampleT>::add(SampleT s)
+void RingBuffer<SampleT>::get_spans(const unsigned long start,
+        const unsigned long end, Span& first, Span& second)
 {
-    // Drop the earliest time if nessecary
-    if(size == buffer_size)
-        start_t++;
-    else
-        size++;
+    check_range(start, end);
+
+    unsigned long i = start & mask;
+    unsigned long n = end - start;
+    first.data = &samples[i];
+    first.size = std::min(n, buffer_size - i);
+    second.data = &samples[0];
+    second.size = n - first.size;
+}
 
+
+template <class SampleT>
+unsigned long RingBuffer<SampleT>::add(SampleT s)
+{
     // Write the sample into the ring
-    unsigned i = end_t % buffer_size;
-    samples[i] = s;
+    samples[end_t & mask] = s;
     end_t++;
 
+    // Drop the earliest time if nessecary
+    if(end_t - start_t > buffer_size)
+        start_t++;
+
     return end_t-1;
 }
 
 
+template <class SampleT>
+unsigned long RingBuffer<SampleT>::add_block(const SampleT* s,
+        unsigned long n)
+{
+    unsigned long first_t = end_t;
+
+    // Only the last buffer_size values can survive
+    if(n > buffer_size)
+    {
+        end_t += n - buffer_size;
+        start_t = end_t;
+        s += n - buffer_size;
+        n = buffer_size;
+    }
+
+    Span first, second;
+    get_write_spans(n, first, second);
+    std::copy(s, s + first.size, first.data);
+    std::copy(s + first.size, s + n, second.data);
+    commit(n);
+
+    return first_t;
+}
+
+
+template <class SampleT>
+void RingBuffer<SampleT>::get_write_spans(unsigned long n, Span& first,
+        Span& second)
+{
+#ifdef CLICKTRACK_DEBUG
+    if(n > buffer_size)
+        throw RingBufferOutOfRange(start_t, end_t, end_t + n);
+#endif
+
+    unsigned long i = end_t & mask;
+    first.data = &samples[i];
+    first.size = std::min(n, buffer_size - i);
+    second.data = &samples[0];
+    second.size = n - first.size;
+}
+
+
+template <class SampleT>
+void RingBuffer<SampleT>::commit(unsigned long n)
+{
+    end_t += n;
+    if(end_t - start_t > buffer_size)
+        start_t = end_t - buffer_size;
+}
+
+
 template <class SampleT>
 unsigned long RingBuffer<SampleT>::get_lowest_timestamp()
 {
@@ -79,7 +148,16 @@ void RingBuffer<SampleT>::set_new_startpoint(unsigned t)
 {
     start_t = t;
     end_t = t;
-    size = 0;
+}
+
+
+template <class SampleT>
+void RingBuffer<SampleT>::check_range(unsigned long start, unsigned long end)
+{
+#ifdef CLICKTRACK_DEBUG
+    if(start < start_t || end > end_t || start > end)
+        throw RingBufferOutOfRange(start_t, end_t, start < start_t ? start : end-1);
+#endif
 }
 
 #endif
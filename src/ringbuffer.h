@@ -11,35 +11,68 @@ namespace ClickTrack{
      * a single statically sized ring, and it can seamlessly wrap around the
      * edge. It appears to be of infinite length as long as you never have more
      * than buffer_size items inside.
+     *
+     * The ring's size is rounded up to a power of two, so that time values
+     * wrap with a mask. Values may be read and written a whole block at a
+     * time, through at most two contiguous spans either side of the wrap.
+     *
+     * Accesses are only range checked when built with CLICKTRACK_DEBUG.
+     * Otherwise, the caller must stay within the timestamps the buffer holds.
      */
     template <class SampleT>
     class RingBuffer
     {
         public:
             /* The constructor allocates the ring array. It can contain as many
-             * as its argument allows.
+             * as its argument allows, rounded up to a power of two.
              */
             RingBuffer(unsigned n_buffer_size);
 
             /* Allows you to ask for values in the currently available time
-             * range of the buffer. If you try to access a time point not
-             * available in the current range, throws exception.
+             * range of the buffer. In debug builds, throws an exception if you
+             * try to access a time point not available in the current range.
              */
             inline SampleT& operator[] (const unsigned long t);
             inline SampleT get(const unsigned long t);
 
-            /* Copies a range of values into a provided buffer. If you try to
-             * access any time points not available in the current range, throws
-             * exception.
+            /* Copies a range of values into a provided buffer. In debug
+             * builds, throws an exception if you try to access any time points
+             * not available in the current range.
              */
             void get_range(std::vector<SampleT>& buffer, 
                     const unsigned long start, const unsigned long end);
 
+            /* A contiguous run of values in the ring
+             */
+            struct Span
+            {
+                SampleT* data;
+                unsigned long size;
+            };
+
+            /* Gets the values for times [start, end) as two spans, the second
+             * of which is empty unless the range wraps around the ring
+             */
+            void get_spans(const unsigned long start, const unsigned long end,
+                    Span& first, Span& second);
+
             /* Adds a sample as the next time step in the buffer. May overwrite
              * the oldest time step. Returns the timestamp of the added value.
              */
             inline unsigned long add(SampleT s);
 
+            /* Adds n samples at once. May overwrite the oldest time steps.
+             * Returns the timestamp of the first added value.
+             */
+            unsigned long add_block(const SampleT* s, unsigned long n);
+
+            /* Gets where the next n values will be written as two spans, so
+             * that they can be filled in place, then adds them to the buffer.
+             * n may not exceed the buffer's size.
+             */
+            void get_write_spans(unsigned long n, Span& first, Span& second);
+            void commit(unsigned long n);
+
             /* Getters to expose the lowest and high timestamp
              */
             inline unsigned long get_lowest_timestamp();
@@ -52,11 +85,16 @@ namespace ClickTrack{
             void set_new_startpoint(unsigned t);
 
         private:
+            /* Helper for debug builds. Throws if a range of times is not held
+             * in the buffer.
+             */
+            inline void check_range(unsigned long start, unsigned long end);
+
             unsigned long start_t; // earliest time still in the buffer
             unsigned long end_t;   // latest time still in the buffer
-            unsigned long size;    // number of samples currently in buffer
 
             unsigned long buffer_size;  // the number of elements in the buffer
+            unsigned long mask;         // buffer_size - 1
             std::vector<SampleT> samples; // the actual ring array
     };
 
@@ -69,17 +107,21 @@ namespace ClickTrack{
         public:
         RingBufferOutOfRange(unsigned long in_start, unsigned long in_end,
                 unsigned long in_t)
-            : start(in_start), end(in_end), t(in_t){}
+            : start(in_start), end(in_end), t(in_t)
+        {
+            snprintf(message, sizeof(message), "%s\n    Buffer range=[%lu-%lu), t=%lu\n",
+                    "The requested time value is not stored in the buffer.",
+                    start, end, t);
+        }
 
         unsigned long start, end, t;
         virtual const char* what() const throw()
         {
-            char* buffer = new char[256];
-            sprintf(buffer, "%s\n    Buffer range=[%lu-%lu), t=%lu\n",
-                    "The requested time value is not stored in the buffer.",
-                    start, end, t);
-            return buffer;
+            return message;
         }
+
+        private:
+        char message[256];
     };
 }
 
@@ -0,0 +1,316 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "rt_log.h"
+
+using namespace ClickTrack;
+
+
+namespace
+{
+    /* A message as it is queued
+     */
+    struct Record
+    {
+        RtLog::Level level;
+        const char* format;
+        unsigned num_args;
+        RtLogArg args[RtLog::max_args];
+    };
+
+
+    /* A bounded lock free queue for many producers and one consumer. Each
+     * slot carries a sequence number, which tells a producer whether the
+     * slot is free for its turn around the ring, and tells the consumer
+     * whether it has been filled.
+     */
+    struct Slot
+    {
+        std::atomic<unsigned long> sequence;
+        Record record;
+    };
+
+
+    /* The state behind RtLog. It is created on first use, and writes out
+     * anything left queued when the program exits.
+     */
+    class Logger
+    {
+        public:
+            Logger();
+            ~Logger();
+
+            bool push(const Record& record);
+            bool allow();
+
+            /* Formats and writes out everything queued. Only one thread may
+             * drain at a time.
+             */
+            void drain();
+
+            std::atomic<int> level;
+            std::atomic<unsigned long> dropped;
+
+        private:
+            void run();
+
+            Slot slots[RtLog::capacity];
+            std::atomic<unsigned long> enqueue_position;
+            unsigned long dequeue_position;
+            std::mutex drain_lock;
+            unsigned long reported_dropped;
+
+            /* The rate limit is a virtual schedule: each message pushes the
+             * time at which the next is due further out, and messages are
+             * refused once it is more than a burst ahead of now
+             */
+            std::atomic<long long> next_due_ns;
+
+            std::atomic<bool> stopping;
+            std::thread thread;
+    };
+
+
+    Logger::Logger()
+        : level(RtLog::INFO), dropped(0), enqueue_position(0),
+          dequeue_position(0), drain_lock(), reported_dropped(0),
+          next_due_ns(0), stopping(false), thread()
+    {
+        for(unsigned i = 0; i < RtLog::capacity; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+
+        thread = std::thread(&Logger::run, this);
+    }
+
+
+    Logger::~Logger()
+    {
+        stopping.store(true);
+        thread.join();
+        drain();
+    }
+
+
+    bool Logger::push(const Record& record)
+    {
+        unsigned long position =
+            enqueue_position.load(std::memory_order_relaxed);
+        Slot* slot;
+        while(true)
+        {
+            slot = &slots[position % RtLog::capacity];
+            unsigned long sequence =
+                slot->sequence.load(std::memory_order_acquire);
+            long difference = (long) sequence - (long) position;
+
+            // Claim the slot if it is free for this turn around the ring
+            if(difference == 0)
+            {
+                if(enqueue_position.compare_exchange_weak(position,
+                            position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(difference < 0)
+                return false; // full
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+
+        // Fill it, then hand it to the consumer
+        slot->record = record;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+
+    bool Logger::allow()
+    {
+        const long long interval = 1000000000LL / RtLog::rate;
+        long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        long long due = next_due_ns.load(std::memory_order_relaxed);
+        while(true)
+        {
+            long long next = (due > now ? due : now) + interval;
+            if(next - now > interval * RtLog::burst)
+                return false;
+            if(next_due_ns.compare_exchange_weak(due, next,
+                        std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+
+    /* Writes one record, filling in its arguments in order. Each conversion
+     * is formatted on its own, with the argument's stored type.
+     */
+    void write_record(const Record& record)
+    {
+        std::ostream& out = record.level == RtLog::WARNING ? std::cerr :
+            std::cout;
+
+        std::string line;
+        unsigned arg = 0;
+        const char* c = record.format;
+        while(*c != '\0')
+        {
+            if(*c != '%')
+            {
+                line += *c++;
+                continue;
+            }
+            if(c[1] == '%')
+            {
+                line += '%';
+                c += 2;
+                continue;
+            }
+
+            // Copy the flags, width and precision, and skip any length, as
+            // the argument's size is known
+            const char* start = c++;
+            std::string spec = "%";
+            while(*c != '\0' && strchr("-+ #0123456789.", *c) != NULL)
+                spec += *c++;
+            while(*c != '\0' && strchr("hlLqjzt", *c) != NULL)
+                c++;
+            char conversion = *c;
+            if(conversion == '\0' || arg >= record.num_args)
+            {
+                line.append(start, c - start);
+                continue;
+            }
+            c++;
+
+            const RtLogArg& value = record.args[arg++];
+            char buffer[64];
+            if(value.type == RtLogArg::STRING)
+            {
+                line += value.s;
+                continue;
+            }
+            else if(strchr("fFeEgGaA", conversion) != NULL)
+            {
+                double f = value.type == RtLogArg::FLOAT ? value.f :
+                    value.type == RtLogArg::INT ? value.i : value.u;
+                snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), f);
+            }
+            else if(conversion == 'c')
+                snprintf(buffer, sizeof(buffer), "%c", (int) value.i);
+            else
+            {
+                if(conversion != 'd' && conversion != 'i' &&
+                        conversion != 'u' && conversion != 'x' &&
+                        conversion != 'X' && conversion != 'o')
+                    conversion = 'd';
+                long long i = value.type == RtLogArg::FLOAT ?
+                    (long long) value.f : value.i;
+                snprintf(buffer, sizeof(buffer),
+                        (spec + "ll" + conversion).c_str(), i);
+            }
+            line += buffer;
+        }
+
+        out << line << std::endl;
+    }
+
+
+    void Logger::drain()
+    {
+        std::lock_guard<std::mutex> guard(drain_lock);
+        while(true)
+        {
+            Slot& slot = slots[dequeue_position % RtLog::capacity];
+            if(slot.sequence.load(std::memory_order_acquire) !=
+                    dequeue_position + 1)
+                break;
+
+            Record record = slot.record;
+            slot.sequence.store(dequeue_position + RtLog::capacity,
+                    std::memory_order_release);
+            dequeue_position++;
+
+            write_record(record);
+        }
+
+        unsigned long now_dropped = dropped.load(std::memory_order_relaxed);
+        if(now_dropped != reported_dropped)
+        {
+            std::cerr << "Dropped " << now_dropped - reported_dropped <<
+                " log messages" << std::endl;
+            reported_dropped = now_dropped;
+        }
+    }
+
+
+    void Logger::run()
+    {
+        // Poll, so that writers never have to wake this thread
+        while(!stopping.load())
+        {
+            drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+
+    /* Programs that never log never start the thread, and messages logged
+     * during static initialization find the logger constructed
+     */
+    Logger& get_logger()
+    {
+        static Logger logger;
+        return logger;
+    }
+}
+
+
+
+
+void RtLog::write(Level level, const char* format, const RtLogArg* args,
+        unsigned num_args)
+{
+    Logger& logger = get_logger();
+    if(level < logger.level.load(std::memory_order_relaxed))
+        return;
+
+    Record record;
+    record.level = level;
+    record.format = format;
+    record.num_args = num_args < max_args ? num_args : max_args;
+    for(unsigned i = 0; i < record.num_args; i++)
+        record.args[i] = args[i];
+
+    if(!logger.allow() || !logger.push(record))
+        logger.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void RtLog::start()
+{
+    get_logger();
+}
+
+
+void RtLog::set_level(Level level)
+{
+    get_logger().level.store(level, std::memory_order_relaxed);
+}
+
+
+void RtLog::flush()
+{
+    get_logger().drain();
+}
+
+
+unsigned long RtLog::get_dropped()
+{
+    return get_logger().dropped.load(std::memory_order_relaxed);
+}
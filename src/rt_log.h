@@ -0,0 +1,102 @@
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+
+namespace ClickTrack
+{
+    /* One argument of a log message. Strings must outlive the message, so
+     * only string literals and other static strings may be logged.
+     */
+    struct RtLogArg
+    {
+        enum Type { INT, UINT, FLOAT, STRING };
+        Type type;
+        union
+        {
+            long long i;
+            unsigned long long u;
+            double f;
+            const char* s;
+        };
+
+        RtLogArg() : type(INT), i(0) {}
+        RtLogArg(int v) : type(INT), i(v) {}
+        RtLogArg(long v) : type(INT), i(v) {}
+        RtLogArg(long long v) : type(INT), i(v) {}
+        RtLogArg(unsigned v) : type(UINT), u(v) {}
+        RtLogArg(unsigned long v) : type(UINT), u(v) {}
+        RtLogArg(unsigned long long v) : type(UINT), u(v) {}
+        RtLogArg(double v) : type(FLOAT), f(v) {}
+        RtLogArg(const char* v) : type(STRING), s(v) {}
+    };
+
+
+    /* RtLog is a logger that is safe to use from the audio thread. Writing
+     * a message never blocks, allocates or formats anything. Instead it
+     * copies a fixed size record, holding a pointer to a static printf style
+     * format string and up to four numeric or static string arguments, into
+     * a preallocated lock free ring. A background thread then formats the
+     * records and writes them out; info to stdout and warnings to stderr.
+     *
+     * Any thread may write. Messages are rate limited, and any that do not
+     * fit in the ring or exceed the rate are dropped and counted. The number
+     * dropped is reported along with the messages that follow.
+     *
+     * EG: RtLog::warning("Ignoring MIDI note: %u", note);
+     */
+    class RtLog
+    {
+        public:
+            enum Level { INFO, WARNING };
+
+            /* Queues a message for writing
+             */
+            template <class... Args>
+            static void info(const char* format, Args... args)
+            {
+                const RtLogArg list[] = { RtLogArg(args)..., RtLogArg(0) };
+                write(INFO, format, list, sizeof...(Args));
+            }
+
+            template <class... Args>
+            static void warning(const char* format, Args... args)
+            {
+                const RtLogArg list[] = { RtLogArg(args)..., RtLogArg(0) };
+                write(WARNING, format, list, sizeof...(Args));
+            }
+
+            static void write(Level level, const char* format,
+                    const RtLogArg* args, unsigned num_args);
+
+            /* Creates the logger and starts its thread, which otherwise
+             * happens on first use. Call before the audio thread starts, so
+             * that its first message does not allocate.
+             */
+            static void start();
+
+            /* Messages below this level are discarded without being counted
+             * as dropped. Defaults to INFO.
+             */
+            static void set_level(Level level);
+
+            /* Writes out every queued message before returning. Not safe to
+             * call from the audio thread.
+             */
+            static void flush();
+
+            /* Returns the number of messages dropped so far
+             */
+            static unsigned long get_dropped();
+
+            /* The most arguments a message may have, the most messages that
+             * may be queued at once, and the sustained rate and burst of
+             * messages allowed per second
+             */
+            static const unsigned max_args = 4;
+            static const unsigned capacity = 1024;
+            static const unsigned rate = 200;
+            static const unsigned burst = 100;
+    };
+}
+
+#endif
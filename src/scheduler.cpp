@@ -6,30 +6,74 @@
 using namespace ClickTrack;
 
 
-template<typename scheduledClass>
-FunctionScheduler<scheduledClass>::FunctionScheduler(scheduledClass& in_caller)
-    : caller(in_caller), event_i(0), events() {}
+template<typename scheduledClass, typename payloadT>
+FunctionScheduler<scheduledClass, payloadT>::FunctionScheduler(
+        scheduledClass& in_caller, unsigned capacity)
+    : caller(in_caller), events(), mask(0), head(0), count(0),
+      next_run_time(0), num_scheduled(0), num_run(0), num_dropped(0)
+{
+    // Round up to a power of two so indices can wrap with a mask
+    unsigned long size = 1;
+    while(size < capacity)
+        size *= 2;
+
+    mask = size - 1;
+    events.resize(size);
+}
+
 
-template<typename scheduledClass>
-void FunctionScheduler<scheduledClass>::schedule(unsigned long time, 
-        callback_t f, void* payload)
+template<typename scheduledClass, typename payloadT>
+bool FunctionScheduler<scheduledClass, payloadT>::schedule(unsigned long time, 
+        callback_t f, payloadT payload)
 {
-    // Push a tuple to the back
-    events.push( {event_i, time, f, payload} );
-    event_i++;
+    // Fast path: the event is already due and nothing is ahead of it
+    if(count == 0 && time < next_run_time)
+    {
+        num_scheduled++;
+        num_run++;
+        f(caller, payload);
+        return true;
+    }
+
+    if(count > mask)
+    {
+        num_dropped++;
+        return false;
+    }
+
+    // Shift any later events back to make room, keeping equal times in first
+    // in first out order
+    unsigned long i = count;
+    while(i > 0 && events[(head + i-1) & mask].t > time)
+    {
+        events[(head + i) & mask] = events[(head + i-1) & mask];
+        i--;
+    }
+
+    event_t& event = events[(head + i) & mask];
+    event.t = time;
+    event.f = f;
+    event.payload = payload;
+
+    count++;
+    num_scheduled++;
+    return true;
 }
 
 
-template<typename scheduledClass>
-unsigned FunctionScheduler<scheduledClass>::run(unsigned long time)
+template<typename scheduledClass, typename payloadT>
+unsigned FunctionScheduler<scheduledClass, payloadT>::run(unsigned long time)
 {
+    next_run_time = time+1;
+
     // Trigger all the found events
     unsigned eventsTriggered = 0;
-    while(!events.empty() && events.top().t <= time)
+    while(count > 0 && events[head & mask].t <= time)
     {
         // Get the event
-        struct event_t event = events.top();
-        events.pop();
+        event_t event = events[head & mask];
+        head++;
+        count--;
         eventsTriggered++;
 
         // Call the event
@@ -37,7 +81,41 @@ unsigned FunctionScheduler<scheduledClass>::run(unsigned long time)
     }
 
     // Return
+    num_run += eventsTriggered;
     return eventsTriggered;
 }
 
+
+template<typename scheduledClass, typename payloadT>
+bool FunctionScheduler<scheduledClass, payloadT>::next_event_time(
+        unsigned long& time)
+{
+    if(count == 0)
+        return false;
+
+    time = events[head & mask].t;
+    return true;
+}
+
+
+template<typename scheduledClass, typename payloadT>
+unsigned long FunctionScheduler<scheduledClass, payloadT>::get_num_scheduled()
+{
+    return num_scheduled;
+}
+
+
+template<typename scheduledClass, typename payloadT>
+unsigned long FunctionScheduler<scheduledClass, payloadT>::get_num_run()
+{
+    return num_run;
+}
+
+
+template<typename scheduledClass, typename payloadT>
+unsigned long FunctionScheduler<scheduledClass, payloadT>::get_num_dropped()
+{
+    return num_dropped;
+}
+
 #endif
@@ -1,7 +1,7 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
-#include <queue>
+#include <vector>
 
 
 namespace ClickTrack
@@ -10,25 +10,37 @@ namespace ClickTrack
      * parameter changes within classes at designated sample times. As
      * a templated class, you may require more than one if you have more than
      * one type for your parameters
+     *
+     * Events and their payloads are stored by value in a ring allocated up
+     * front, so scheduling and running events never touches the heap. This
+     * makes it safe to use from the audio thread.
      */
-    template <class scheduledClass>
+    template <class scheduledClass, class payloadT>
     class FunctionScheduler
     {
         public:
-            FunctionScheduler(scheduledClass& in_caller);
+            /* The scheduler can hold up to capacity pending events, rounded
+             * up to a power of two
+             */
+            FunctionScheduler(scheduledClass& in_caller, unsigned capacity=512);
 
             /* The function scheduler requires a callback function of the
              * following arguments:
-             *     2. a reference to the calling object
-             *     3. a void* payload that will be passed back to the callbak
+             *     1. a reference to the calling object
+             *     2. the payload that was scheduled with it
              */
-            typedef void (*callback_t)(scheduledClass& caller, void* payload);
+            typedef void (*callback_t)(scheduledClass& caller, 
+                    payloadT payload);
 
             /* To schedule an event, you must pass the time of the event,
-             * a reference to the object caller, the function being called, and
-             * the value to change it to.
+             * the function being called, and the value to change it to.
+             *
+             * Events scheduled for the same time run in the order they were
+             * scheduled. If nothing is pending and the time has already been
+             * run, the event is triggered immediately. If the scheduler is
+             * full, the event is dropped and false is returned.
              */
-            void schedule(unsigned long time, callback_t f, void* payload);
+            bool schedule(unsigned long time, callback_t f, payloadT payload);
 
             /* Run must be called within the processing loop of your target
              * class at every sample time. It takes the time to process for, and
@@ -37,33 +49,42 @@ namespace ClickTrack
              *
              * Returns the number of events processed
              */
-            unsigned run(unsigned long time);
+            inline unsigned run(unsigned long time);
+
+            /* Gets the time of the next pending event, so that the caller can
+             * process everything before it in one pass. Returns false if
+             * nothing is pending.
+             */
+            inline bool next_event_time(unsigned long& time);
+
+            /* Counters of the events handled over the scheduler's lifetime.
+             * These should be read from the same thread that schedules.
+             */
+            unsigned long get_num_scheduled();
+            unsigned long get_num_run();
+            unsigned long get_num_dropped();
 
         private:
             /* Store the calling class so we can trigger its events
              */
             scheduledClass& caller;
 
-            /* Internally, we map sample timestamps to their time, function,
-             * and payload to be triggered. Events are ordered by their time and
-             * stored in a priority queue. Attach an index to ensure first in
-             * first out ordering
+            /* Events are kept sorted by time in a ring. They are usually
+             * scheduled in order, so insertion rarely moves anything.
+             */
+            struct event_t { unsigned long t; callback_t f; payloadT payload; };
+            std::vector<event_t> events;
+            unsigned long mask;
+            unsigned long head;
+            unsigned long count;
+
+            /* The earliest time that has not yet been run
              */
-            unsigned event_i;
-            struct event_t { unsigned i; unsigned long t; callback_t f; 
-                void* payload; };
-            struct event_t_comp
-            { 
-                bool operator()(const struct event_t e1, const struct event_t e2)
-                {
-                    if(e1.t == e2.t)
-                        return e1.i > e2.i;
-                    return e1.t > e2.t;
-                }
-            };
+            unsigned long next_run_time;
 
-            std::priority_queue<struct event_t, std::vector<struct event_t>,
-                struct event_t_comp> events;
+            unsigned long num_scheduled;
+            unsigned long num_run;
+            unsigned long num_dropped;
     };
 }
 
@@ -0,0 +1,185 @@
+#include "signal_graph.h"
+
+using namespace ClickTrack;
+
+
+SignalGraph::SignalGraph(unsigned in_num_threads)
+    : consumers(), added_generators(), built(false), order(), marked(),
+      marks(), indices(), dependents(), num_dependencies(), roots(),
+      pending(), num_threads(in_num_threads), pool(NULL)
+{}
+
+
+SignalGraph::~SignalGraph()
+{
+    delete pool;
+}
+
+
+void SignalGraph::add_consumer(AudioConsumer* consumer)
+{
+    consumers.push_back(consumer);
+    built = false;
+}
+
+
+void SignalGraph::add_generator(AudioGenerator* generator)
+{
+    added_generators.push_back(generator);
+    built = false;
+}
+
+
+void SignalGraph::build()
+{
+    built = false;
+    order.clear();
+    marked.clear();
+    marks.clear();
+    indices.clear();
+    dependents.clear();
+    num_dependencies.clear();
+    roots.clear();
+
+    // Walk back from each consumer through its inputs
+    for(unsigned i = 0; i < consumers.size(); i++)
+    {
+        AudioConsumer* consumer = consumers[i];
+        for(unsigned j = 0; j < consumer->input_channels.size(); j++)
+        {
+            Channel* channel = consumer->input_channels[j];
+            if(channel == NULL)
+                throw GraphNodeDisconnected();
+            visit(&channel->parent);
+        }
+    }
+
+    // Anything the user added must have been reached from a consumer
+    for(unsigned i = 0; i < added_generators.size(); i++)
+    {
+        unsigned node = find_node(added_generators[i]);
+        if(node == marked.size() || marks[node] != VISITED)
+            throw GraphNodeDisconnected();
+    }
+
+    // Prepare for parallel execution
+    for(unsigned i = 0; i < order.size(); i++)
+    {
+        if(num_dependencies[i] == 0)
+            roots.push_back(i);
+    }
+    pending = std::vector< std::atomic<unsigned> >(order.size());
+
+    if(num_threads > 1)
+    {
+        delete pool;
+        pool = new WorkerPool(num_threads, order.size());
+    }
+
+    built = true;
+}
+
+
+void SignalGraph::run_block()
+{
+    if(!built)
+        throw GraphNotBuilt();
+
+    if(pool == NULL)
+    {
+        // Generators are ordered so that their inputs are always ready, so
+        // none of them will ever pull from a parent lazily
+        for(unsigned i = 0; i < order.size(); i++)
+            order[i]->generate();
+    }
+    else
+    {
+        // Each generator is queued once its last dependency finishes
+        for(unsigned i = 0; i < order.size(); i++)
+            pending[i].store(num_dependencies[i], std::memory_order_relaxed);
+        pool->run(roots, order.size(), &SignalGraph::run_node, this);
+    }
+
+    for(unsigned i = 0; i < consumers.size(); i++)
+        consumers[i]->consume_block();
+}
+
+
+unsigned SignalGraph::get_num_generators()
+{
+    return order.size();
+}
+
+
+AudioGenerator* SignalGraph::get_generator(unsigned i)
+{
+    return order[i];
+}
+
+
+unsigned SignalGraph::visit(AudioGenerator* generator)
+{
+    unsigned node = find_node(generator);
+    if(node == marked.size())
+    {
+        marked.push_back(generator);
+        marks.push_back(UNVISITED);
+        indices.push_back(0);
+    }
+
+    if(marks[node] == VISITED)
+        return indices[node];
+    if(marks[node] == VISITING)
+        throw GraphCycleDetected();
+    marks[node] = VISITING;
+
+    // Visit everything we depend on first
+    std::vector<Channel*> channels;
+    generator->get_dependencies(channels);
+
+    std::vector<unsigned> parents;
+    for(unsigned i = 0; i < channels.size(); i++)
+    {
+        if(channels[i] == NULL)
+            throw GraphNodeDisconnected();
+        parents.push_back(visit(&channels[i]->parent));
+    }
+
+    // Then add ourselves to the order and record the edges
+    unsigned index = order.size();
+    order.push_back(generator);
+    dependents.push_back(std::vector<unsigned>());
+    num_dependencies.push_back(parents.size());
+    for(unsigned i = 0; i < parents.size(); i++)
+        dependents[parents[i]].push_back(index);
+
+    marks[node] = VISITED;
+    indices[node] = index;
+    return index;
+}
+
+
+unsigned SignalGraph::find_node(AudioGenerator* generator)
+{
+    for(unsigned i = 0; i < marked.size(); i++)
+    {
+        if(marked[i] == generator)
+            return i;
+    }
+    return marked.size();
+}
+
+
+void SignalGraph::run_node(unsigned node, unsigned worker, void* payload)
+{
+    SignalGraph* graph = (SignalGraph*) payload;
+    graph->order[node]->generate();
+
+    // The last dependency to finish queues each dependent
+    std::vector<unsigned>& next = graph->dependents[node];
+    for(unsigned i = 0; i < next.size(); i++)
+    {
+        if(graph->pending[next[i]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            graph->pool->spawn(worker, next[i]);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef SIGNAL_GRAPH_H
+#define SIGNAL_GRAPH_H
+
+#include <atomic>
+#include <exception>
+#include <vector>
+#include "audio_generics.h"
+#include "worker_pool.h"
+
+
+namespace ClickTrack
+{
+    /* The signal graph is an executor for a connected signal chain. Rather
+     * than pulling audio lazily backwards from the consumer one block at
+     * a time, it walks the chain once when built and computes a flat
+     * execution order. Each block, every generator is then run exactly once
+     * in that order, and finally each consumer.
+     *
+     * The graph only needs to be told about its consumers; every generator
+     * feeding them is found through their input channels. Generators may also
+     * be added explicitly, in which case building fails if they do not feed
+     * any consumer.
+     *
+     * The graph must be rebuilt if the chain is reconnected.
+     *
+     * Given more than one thread, the graph runs independent branches of the
+     * chain in parallel on a work stealing pool. Each generator is started as
+     * soon as everything it depends on has finished. The consumers are still
+     * run on the calling thread.
+     */
+    class SignalGraph
+    {
+        public:
+            SignalGraph(unsigned num_threads = 1);
+            ~SignalGraph();
+
+            /* Adds a node to the graph. Consumers are the ends of the signal
+             * chain, and are run last.
+             */
+            void add_consumer(AudioConsumer* consumer);
+            void add_generator(AudioGenerator* generator);
+
+            /* Computes the execution order. Throws GraphCycleDetected if the
+             * chain contains a loop, and GraphNodeDisconnected if an input is
+             * left unconnected or an added generator feeds no consumer.
+             */
+            void build();
+
+            /* Runs every node in the graph once, rendering one block of
+             * BUFFER_SIZE samples. The graph must have been built.
+             */
+            void run_block();
+
+            /* Exposes the computed execution order
+             */
+            unsigned get_num_generators();
+            AudioGenerator* get_generator(unsigned i);
+
+        private:
+            /* Helper for build. Visits a generator after all the generators
+             * it depends on, appending it to the execution order. Returns its
+             * index in that order.
+             */
+            enum Mark { UNVISITED, VISITING, VISITED };
+            unsigned visit(AudioGenerator* generator);
+            unsigned find_node(AudioGenerator* generator);
+
+            /* Task callback for the worker pool. Runs one generator, then
+             * queues any dependents that are now ready.
+             */
+            static void run_node(unsigned node, unsigned worker, void* payload);
+
+            /* The nodes as added by the user
+             */
+            std::vector<AudioConsumer*> consumers;
+            std::vector<AudioGenerator*> added_generators;
+
+            /* The computed execution order, and scratch state for building it
+             */
+            bool built;
+            std::vector<AudioGenerator*> order;
+            std::vector<AudioGenerator*> marked;
+            std::vector<Mark> marks;
+            std::vector<unsigned> indices;
+
+            /* The edges of the graph, for parallel execution. Roots have no
+             * dependencies, and pending counts down the unfinished
+             * dependencies of each node during a block.
+             */
+            std::vector< std::vector<unsigned> > dependents;
+            std::vector<unsigned> num_dependencies;
+            std::vector<unsigned> roots;
+            std::vector< std::atomic<unsigned> > pending;
+
+            const unsigned num_threads;
+            WorkerPool* pool;
+    };
+
+
+    /* Exceptions thrown when building the graph
+     */
+    class GraphCycleDetected: public std::exception
+    {
+        virtual const char* what() const throw()
+        {
+            return "The signal graph contains a cycle.";
+        }
+    };
+    class GraphNodeDisconnected: public std::exception
+    {
+        virtual const char* what() const throw()
+        {
+            return "The signal graph contains a disconnected node.";
+        }
+    };
+    class GraphNotBuilt: public std::exception
+    {
+        virtual const char* what() const throw()
+        {
+            return "The signal graph must be built before it is run.";
+        }
+    };
+}
+
+#endif
@@ -3,8 +3,9 @@
 using namespace ClickTrack;
 
 
-Speaker::Speaker(unsigned num_inputs, bool defaultDevice)
-    : AudioConsumer(num_inputs), buffer(), stream(num_inputs,defaultDevice),
+Speaker::Speaker(unsigned num_inputs, bool defaultDevice, unsigned render_ahead)
+    : AudioConsumer(num_inputs), buffer(),
+      stream(num_inputs, defaultDevice, render_ahead),
       callback(NULL), payload(NULL)
 {
     for(unsigned i = 0; i < num_inputs; i++)
@@ -30,8 +31,32 @@ void Speaker::process_inputs(std::vector<SAMPLE>& inputs, unsigned long t)
 }
 
 
+void Speaker::process_block(std::vector< std::vector<SAMPLE> >& inputs,
+        unsigned long t)
+{
+    // A whole block is exactly one buffer, so write it out directly
+    stream.writeToStream(inputs);
+
+    // Run the callback
+    if(callback != NULL)
+        callback(t + BUFFER_SIZE, payload);
+}
+
+
 void Speaker::register_callback(callback_t in_callback, void* in_payload)
 {
     callback = in_callback;
     payload = in_payload;
 }
+
+
+unsigned long Speaker::get_underruns()
+{
+    return stream.get_underruns();
+}
+
+
+double Speaker::get_latency()
+{
+    return stream.get_latency();
+}
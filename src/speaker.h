@@ -9,11 +9,21 @@ namespace ClickTrack
 {
     /* The speaker is an output device. It uses the default output device on
      * your computer, and pushes its data out to portaudio.
+     *
+     * Given a render ahead depth, the speaker uses callback output, and may
+     * be consumed up to that many buffers ahead of the device. See
+     * OutputStream.
      */
     class Speaker : public AudioConsumer
     {
         public:
-            Speaker(unsigned num_inputs = 1, bool defaultDevice=true);
+            Speaker(unsigned num_inputs = 1, bool defaultDevice=true,
+                    unsigned render_ahead=0);
+
+            /* Expose the output statistics of callback mode
+             */
+            unsigned long get_underruns();
+            double get_latency();
 
             /* This callback is called whenever we write out to the stream. It
              * passes the starting time of next the buffer to be filled, and the
@@ -24,6 +34,8 @@ namespace ClickTrack
 
         private:
             void process_inputs(std::vector<SAMPLE>& input, unsigned long t);
+            void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                    unsigned long t);
 
             /* Store our stream results
              */
@@ -0,0 +1,129 @@
+#ifndef SPSC_QUEUE_CPP
+#define SPSC_QUEUE_CPP
+
+#include <algorithm>
+#include "spsc_queue.h"
+
+using namespace ClickTrack;
+
+
+template <class T>
+SpscQueue<T>::SpscQueue(unsigned capacity)
+    : head(), tail(), mask(0), items()
+{
+    head.index.store(0, std::memory_order_relaxed);
+    head.other = 0;
+    tail.index.store(0, std::memory_order_relaxed);
+    tail.other = 0;
+
+    // Round up to a power of two so indices can wrap with a mask
+    unsigned long size = 1;
+    while(size < capacity)
+        size *= 2;
+
+    mask = size - 1;
+    items.resize(size);
+}
+
+
+template <class T>
+bool SpscQueue<T>::push(const T& item)
+{
+    // Only look at the consumer's progress when we seem to be full
+    unsigned long t = tail.index.load(std::memory_order_relaxed);
+    if(t - tail.other > mask)
+    {
+        tail.other = head.index.load(std::memory_order_acquire);
+        if(t - tail.other > mask)
+            return false;
+    }
+
+    // Write the item before publishing it to the consumer
+    items[t & mask] = item;
+    tail.index.store(t+1, std::memory_order_release);
+    return true;
+}
+
+
+template <class T>
+unsigned SpscQueue<T>::push(const T* in, unsigned n)
+{
+    unsigned long t = tail.index.load(std::memory_order_relaxed);
+    if(t - tail.other + n > mask + 1)
+        tail.other = head.index.load(std::memory_order_acquire);
+    unsigned long room = mask + 1 - (t - tail.other);
+    if(n > room)
+        n = room;
+
+    // Write the items in up to two runs, then publish them all at once
+    unsigned long i = t & mask;
+    unsigned long first = std::min((unsigned long) n, mask + 1 - i);
+    std::copy(in, in + first, items.begin() + i);
+    std::copy(in + first, in + n, items.begin());
+    tail.index.store(t+n, std::memory_order_release);
+    return n;
+}
+
+
+template <class T>
+bool SpscQueue<T>::pop(T& item)
+{
+    // Only look at the producer's progress when we seem to be empty
+    unsigned long h = head.index.load(std::memory_order_relaxed);
+    if(h == head.other)
+    {
+        head.other = tail.index.load(std::memory_order_acquire);
+        if(h == head.other)
+            return false;
+    }
+
+    // Read the item before handing its slot back to the producer
+    item = items[h & mask];
+    head.index.store(h+1, std::memory_order_release);
+    return true;
+}
+
+
+template <class T>
+unsigned SpscQueue<T>::pop(T* out, unsigned n)
+{
+    unsigned long h = head.index.load(std::memory_order_relaxed);
+    if(head.other - h < n)
+        head.other = tail.index.load(std::memory_order_acquire);
+    unsigned long available = head.other - h;
+    if(n > available)
+        n = available;
+
+    // Read the items in up to two runs, then hand all their slots back
+    unsigned long i = h & mask;
+    unsigned long first = std::min((unsigned long) n, mask + 1 - i);
+    std::copy(items.begin() + i, items.begin() + i + first, out);
+    std::copy(items.begin(), items.begin() + (n - first), out + first);
+    head.index.store(h+n, std::memory_order_release);
+    return n;
+}
+
+
+template <class T>
+const T* SpscQueue<T>::front()
+{
+    unsigned long h = head.index.load(std::memory_order_relaxed);
+    if(h == head.other)
+    {
+        head.other = tail.index.load(std::memory_order_acquire);
+        if(h == head.other)
+            return NULL;
+    }
+
+    return &items[h & mask];
+}
+
+
+template <class T>
+unsigned SpscQueue<T>::size()
+{
+    return tail.index.load(std::memory_order_acquire) -
+        head.index.load(std::memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* SpscQueue is a template for a lock free queue between exactly one
+     * producer thread and one consumer thread. It never allocates after
+     * construction and never blocks, so it is safe to use from the audio
+     * thread.
+     *
+     * push may only be called from the producer, and pop and front only from
+     * the consumer. Items may be moved one at a time, or many at once with
+     * at most two copies and a single publish.
+     */
+    template <class T>
+    class SpscQueue
+    {
+        public:
+            /* The constructor allocates the ring. The capacity is rounded up
+             * to a power of two.
+             */
+            SpscQueue(unsigned capacity);
+
+            /* Adds an item to the back of the queue. Returns false and drops
+             * the item if the queue is full.
+             */
+            bool push(const T& item);
+
+            /* Adds up to n items to the back of the queue, as many as there
+             * is room for. Returns the number added.
+             */
+            unsigned push(const T* items, unsigned n);
+
+            /* Removes the item at the front of the queue. Returns false if the
+             * queue is empty.
+             */
+            bool pop(T& item);
+
+            /* Removes up to n items from the front of the queue, as many as
+             * there are. Returns the number removed.
+             */
+            unsigned pop(T* items, unsigned n);
+
+            /* Returns the item at the front of the queue without removing it,
+             * or NULL if the queue is empty. The item remains valid until it
+             * is popped.
+             */
+            const T* front();
+
+            /* Returns the number of items in the queue. This is only
+             * a snapshot if the other thread is active.
+             */
+            unsigned size();
+
+        private:
+            /* The index owned by one thread, and that thread's last reading
+             * of the other thread's index. Each sits on its own cache line,
+             * so the two threads only share a line when they need to look
+             * at each other's progress.
+             */
+            static const unsigned CACHE_LINE = 64;
+            struct Side
+            {
+                char padding_before[CACHE_LINE];
+                std::atomic<unsigned long> index;
+                unsigned long other;
+                char padding_after[CACHE_LINE];
+            };
+
+            /* The consumer owns head and the producer owns tail. Both count
+             * up forever and are masked to index the ring.
+             */
+            Side head;
+            Side tail;
+
+            unsigned long mask;
+            std::vector<T> items;
+    };
+}
+
+#include "spsc_queue.cpp"
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef TRIPLE_BUFFER_CPP
+#define TRIPLE_BUFFER_CPP
+
+#include "triple_buffer.h"
+
+using namespace ClickTrack;
+
+
+template <class T>
+TripleBuffer<T>::TripleBuffer(const T& initial)
+    : buffers{initial, initial, initial}, middle(1), back(0), front(2)
+{}
+
+
+template <class T>
+T& TripleBuffer<T>::get_write_buffer()
+{
+    return buffers[back];
+}
+
+
+template <class T>
+void TripleBuffer<T>::publish()
+{
+    // Release our writes along with the copy, and take back whichever copy
+    // was in the middle
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+
+template <class T>
+bool TripleBuffer<T>::update()
+{
+    if(!(middle.load(std::memory_order_relaxed) & FRESH))
+        return false;
+
+    front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+    return true;
+}
+
+
+template <class T>
+const T& TripleBuffer<T>::get_read_buffer()
+{
+    return buffers[front];
+}
+
+#endif
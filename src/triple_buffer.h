@@ -0,0 +1,60 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+
+namespace ClickTrack
+{
+    /* TripleBuffer is a template for handing the latest version of a value
+     * from one writer thread to one reader thread. Neither side ever blocks
+     * or waits for the other, so it is safe to use from the audio thread.
+     * Versions the reader never saw are simply replaced.
+     *
+     * It holds three copies of the value. The writer fills its own copy and
+     * publishes it by swapping it with the middle one. The reader swaps the
+     * middle one for its own whenever a newer version is there. Values may
+     * own memory, as long as it is allocated up front, as the copies are
+     * swapped and never copied.
+     */
+    template <class T>
+    class TripleBuffer
+    {
+        public:
+            /* Each copy starts as a copy of the given value
+             */
+            TripleBuffer(const T& initial = T());
+
+            /* The copy only the writer may change. Publish makes it
+             * available to the reader, and hands the writer another copy to
+             * fill, holding an older version.
+             */
+            T& get_write_buffer();
+            void publish();
+
+            /* Swaps in the latest published version, if there is a newer one
+             * than the reader holds. Returns true if there was.
+             */
+            bool update();
+
+            /* The copy only the reader may look at
+             */
+            const T& get_read_buffer();
+
+        private:
+            T buffers[3];
+
+            /* The middle copy's index, with a flag set when it is newer than
+             * the reader's
+             */
+            static const unsigned FRESH = 4;
+            std::atomic<unsigned> middle;
+
+            unsigned back;  // the writer's copy
+            unsigned front; // the reader's copy
+    };
+}
+
+#include "triple_buffer.cpp"
+
+#endif
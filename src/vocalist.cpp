@@ -1,26 +1,51 @@
+#include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <iostream>
-#include <iomanip>
+#include "lattice_filter.h"
+#include "rt_log.h"
 #include "vocalist.h"
 
 using namespace ClickTrack;
 
 
-Vocalist::Vocalist()
+/* The power of the residual of a lattice's predictor relative to the signal.
+ * A lattice excited by noise is louder by its inverse.
+ */
+static double prediction_error_ratio(const float* ks, unsigned poles)
+{
+    double ratio = 1.0;
+    for(unsigned i = 0; i < poles; i++)
+        ratio *= 1.0 - (double) ks[i]*ks[i];
+    return ratio;
+}
+
+
+Vocalist::Vocalist(unsigned num_voices)
     : GenericInstrument(), 
 
-      vibrato_lfo(Oscillator::Sine, 5),
-      voice(Oscillator::BlepSaw, 220),
+      vibrato_lfo(Oscillator::TableSine, 5),
       noise(Oscillator::WhiteNoise, 0),
-      tremelo_lfo(Oscillator::Sine, 5),
+      tremelo_lfo(Oscillator::TableSine, 5),
       tremelo(-12),
 
       attack_modifier(1.0),
       attack_duration(0), // set based on consonant
       release_duration(4000),
+      steal_duration(256),
       glide_duration(2000),
-      held_interpolate_duration(500) //500
+      held_interpolate_duration(500), //500
+
+      coeff_storage(),
+      coeff_table(NULL),
+
+      voices(num_voices > 0 ? num_voices : 1),
+
+      vibrato_block(BUFFER_SIZE),
+      voiced_blocks(voices.size(), std::vector<SAMPLE>(BUFFER_SIZE)),
+      unvoiced_block(BUFFER_SIZE),
+      excitation(BUFFER_SIZE*voices.size()),
+      envelopes(BUFFER_SIZE*voices.size()),
+      gains_out(BUFFER_SIZE*voices.size()),
+      lattice_out(BUFFER_SIZE*voices.size())
 {
     /* Configure signal chain
      */
@@ -28,78 +53,167 @@ Vocalist::Vocalist()
     
     /* Configure LFOs
      */
-    voice.set_lfo_input(vibrato_lfo.get_output_channel());
-    voice.set_lfo_intensity(0.1);
-
     tremelo.set_lfo_input(tremelo_lfo.get_output_channel());
     tremelo.set_lfo_intensity(0.0);
 
     /* Load our sound sets
      */
-    load_sound(A, "data/A.dat");
-    load_sound(E, "data/E.dat");
-    load_sound(I, "data/I.dat");
-    load_sound(O, "data/O.dat");
-    load_sound(U, "data/U.dat");
+    ModelPack model("data/vocalist.pack");
+    num_coeffs = model.get_num_coeffs();
+
+    // Pad each row of the table out to whole, aligned cache lines
+    const unsigned row_align = 64 / sizeof(float);
+    coeff_stride = (num_coeffs + row_align-1) / row_align * row_align;
+    coeff_storage.resize(NUM_SOUNDS*coeff_stride + row_align, 0.0);
+    coeff_table = &coeff_storage[0];
+    while(((unsigned long) coeff_table) % 64 != 0)
+        coeff_table++;
+
+    for(unsigned i = 0; i < NUM_SOUNDS; i++)
+    {
+        sound_gains[i] = 1.0;
+        trajectory_start[i] = 0;
+        trajectory_frames[i] = 0;
+    }
+    trajectory_target.resize(num_coeffs, 0.0);
 
-    load_sound(V, "data/V.dat");
-    load_sound(Z, "data/Z.dat");
+    load_sound(model, A, "A");
+    load_sound(model, E, "E");
+    load_sound(model, I, "I");
+    load_sound(model, O, "O");
+    load_sound(model, U, "U");
 
-    load_sound(L, "data/L.dat");
-    load_sound(M, "data/M.dat");
-    load_sound(N, "data/N.dat");
+    load_sound(model, V, "V");
+    load_sound(model, Z, "Z");
 
-    load_sound(T, "data/T.dat");
-    load_sound(P, "data/P.dat");
-    load_sound(K, "data/K.dat");
+    load_sound(model, L, "L");
+    load_sound(model, M, "M");
+    load_sound(model, N, "N");
 
-    /* Initialize our containers
-     */
-    gain = 0;
-    gain_delta = 0;
+    load_sound(model, T, "T");
+    load_sound(model, P, "P");
+    load_sound(model, K, "K");
 
-    reflection_coeffs.push_back(0.0); //zeroth element never accessed
-    reflection_coeffs_delta.push_back(0.0);
-    forward_errors.push_back(0.0);
-    backward_errors.push_back(0.0);
+    /* Initialize our containers. The zeroth coefficient of each lattice is
+     * never accessed
+     */
+    reflection_coeffs.resize((num_coeffs+1)*voices.size(), 0.0);
+    reflection_coeffs_delta.resize((num_coeffs+1)*voices.size(), 0.0);
+    backward_errors.resize((num_coeffs+1)*voices.size(), 0.0);
 
-    for(unsigned i = 0; i < num_coeffs; i++)
-    {
-        reflection_coeffs.push_back(0.0);
-        reflection_coeffs_delta.push_back(0.0);
-        forward_errors.push_back(0.0);
-        backward_errors.push_back(0.0);
-    }
+    lattice_start = 0;
+    lattice_end = 0;
+    num_active = 0;
 
     /* Initialize our play state
      */
-    playing = false;
     sustained = false;
-    held = false;
-
-    note = 0;
+    steal_policy = STEAL_OLDEST;
+    live_input = NULL;
+    live_return_sound = I;
+    live_loudness = 1.0;
     pitch_multiplier = 1.0;
 
-    gliding = false;
-    interpolating = false;
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        Voice& voice = voices[v];
+        voice.source = new Oscillator(Oscillator::TableSaw, 220);
+        voice.source->set_lfo_intensity(0.1);
+
+        voice.note = 0;
+        voice.playing = false;
+        voice.held = false;
+
+        voice.current_state = SILENT;
+        voice.start_time = 0;
+        voice.attack_time = 0;
+        voice.release_time = 0;
+
+        voice.stealing = false;
+        voice.steal_time = 0;
+        voice.steal_freq = 0.0;
+
+        voice.glide_end = 0;
+        voice.current_freq = 0.0;
+
+        voice.on_trajectory = false;
+        voice.trajectory = NUM_SOUNDS;
+
+        voice.interpolating = false;
+        voice.interpolate_duration = 0;
+        voice.interpolate_time = 0;
+        voice.gain_delta = 0;
 
-    current_state = SILENT;
+        voice.gain = 0;
+        voice.level = 0.0;
+
+        voice.lattice_interpolating = false;
+    }
 
     /* Initialize our default sounds
      */
-    set_hold(I);
+    set_hold(I, 0);
     set_attack(H);
 }
 
 
+Vocalist::~Vocalist()
+{
+    for(unsigned v = 0; v < voices.size(); v++)
+        delete voices[v].source;
+}
+
+
 Channel* Vocalist::get_output_channel()
 {
     return tremelo.get_output_channel();
 }
 
 
+void Vocalist::set_steal_policy(StealPolicy policy)
+{
+    steal_policy = policy;
+}
+
+
+unsigned Vocalist::get_num_voices()
+{
+    return voices.size();
+}
+
+
+void Vocalist::set_live_input(LpcAnalyzer* analyzer, unsigned long time)
+{
+    if(analyzer == NULL)
+    {
+        if(live_input != NULL)
+            set_hold(live_return_sound, time);
+        live_input = NULL;
+        live_return_sound = I;
+        live_loudness = 1.0;
+        return;
+    }
+
+    // Sing as the vowel being held until a model arrives, and as loudly
+    // after
+    if(live_input == NULL)
+        live_return_sound = held_sound;
+    live_input = analyzer;
+    live_loudness = sound_gains[live_return_sound] / sqrt(
+            prediction_error_ratio(get_sound_coeffs(live_return_sound),
+                num_coeffs));
+    sound_gains[LIVE] = sound_gains[live_return_sound];
+    std::copy(get_sound_coeffs(live_return_sound),
+            get_sound_coeffs(live_return_sound) + num_coeffs,
+            coeff_table + LIVE*coeff_stride);
+}
+
+
 void Vocalist::on_note_down(unsigned in_note, float velocity, unsigned long time)
 {
+    if(time == 0)
+        time = get_next_time();
+
     // Check what note was playing and decide our action
     // The second octave is mapped to changing the vocal sounds
     // The third octave (C3 to E4) is or performance range
@@ -110,122 +224,133 @@ void Vocalist::on_note_down(unsigned in_note, float velocity, unsigned long time
         {
             // Vowels
             case 37:
-                std::cout << "Setting vowel to A" << std::endl;
-                set_hold(A);
+                RtLog::info("Setting vowel to A");
+                set_hold(A, time);
                 break;
             case 39:
-                std::cout << "Setting vowel to E" << std::endl;
-                set_hold(E);
+                RtLog::info("Setting vowel to E");
+                set_hold(E, time);
                 break;
             case 42:
-                std::cout << "Setting vowel to I" << std::endl;
-                set_hold(I);
+                RtLog::info("Setting vowel to I");
+                set_hold(I, time);
                 break;
             case 44:
-                std::cout << "Setting vowel to O" << std::endl;
-                set_hold(O);
+                RtLog::info("Setting vowel to O");
+                set_hold(O, time);
                 break;
             case 46:
-                std::cout << "Setting vowel to U" << std::endl;
-                set_hold(U);
+                RtLog::info("Setting vowel to U");
+                set_hold(U, time);
                 break;
 
             // Primary consonants
             case 36:
-                std::cout << "Setting attack to H" << std::endl;
+                RtLog::info("Setting attack to H");
                 set_attack(H);
                 break;
             case 38:
-                std::cout << "Setting attack to T" << std::endl;
+                RtLog::info("Setting attack to T");
                 set_attack(T);
                 break;
             case 40:
-                std::cout << "Setting attack to D" << std::endl;
+                RtLog::info("Setting attack to D");
                 set_attack(D);
                 break;
             case 41:
-                std::cout << "Setting attack to F" << std::endl;
+                RtLog::info("Setting attack to F");
                 set_attack(F);
                 break;
             case 43:
-                std::cout << "Setting attack to V" << std::endl;
+                RtLog::info("Setting attack to V");
                 set_attack(V);
                 break;
             case 45:
-                std::cout << "Setting attack to L" << std::endl;
+                RtLog::info("Setting attack to L");
                 set_attack(L);
                 break;
             case 47:
-                std::cout << "Setting attack to M" << std::endl;
+                RtLog::info("Setting attack to M");
                 set_attack(M);
                 break;
 
             // Secondary consonants
             case 35:
-                std::cout << "Setting attack to N" << std::endl;
+                RtLog::info("Setting attack to N");
                 set_attack(N);
                 break;
             case 33:
-                std::cout << "Setting attack to G" << std::endl;
+                RtLog::info("Setting attack to G");
                 set_attack(G);
                 break;
             case 31:
-                std::cout << "Setting attack to K" << std::endl;
+                RtLog::info("Setting attack to K");
                 set_attack(K);
                 break;
             case 29:
-                std::cout << "Setting attack to B" << std::endl;
+                RtLog::info("Setting attack to B");
                 set_attack(B);
                 break;
             case 28:
-                std::cout << "Setting attack to P" << std::endl;
+                RtLog::info("Setting attack to P");
                 set_attack(P);
                 break;
             case 26:
-                std::cout << "Setting attack to Z" << std::endl;
+                RtLog::info("Setting attack to Z");
                 set_attack(Z);
                 break;
             case 24:
-                std::cout << "Setting attack to S" << std::endl;
+                RtLog::info("Setting attack to S");
                 set_attack(S);
                 break;
 
             default:
-                std::cout << "Ignoring sound change" << std::endl;
+                RtLog::info("Ignoring sound change");
                 break;
         }
     }
     else if(48 <= in_note && in_note <= 64) // sing note
     {
         // Update the state
-        note = in_note;
-        held = true;
-        playing = true;
-
-        // Trigger the changes
-        handle_note_down(midiNoteToFreq(note));
+        unsigned v = allocate_voice(in_note, time);
+        voices[v].note = in_note;
+        voices[v].held = true;
+        voices[v].playing = true;
+
+        // Trigger the changes, once a stolen voice has faded out
+        if(voices[v].stealing)
+            voices[v].steal_freq = midiNoteToFreq(in_note);
+        else
+            handle_note_down(v, midiNoteToFreq(in_note), time);
     }
     else // alert out of range
     {
-        std::cout << "Ignoring MIDI note: " << in_note << std::endl;
+        RtLog::info("Ignoring MIDI note: %u", in_note);
     }
 }
 
 
 void Vocalist::on_note_up(unsigned in_note, float velocity, unsigned long time)
 {
-    // Ignore other notes
-    if(note != in_note)
-        return;
-    
-    // If we are holding the key down...
-    if(held)
+    if(time == 0)
+        time = get_next_time();
+
+    for(unsigned v = 0; v < voices.size(); v++)
     {
-        held = false;
-        if(playing && !sustained)
+        // Ignore other notes
+        Voice& voice = voices[v];
+        if(voice.note != in_note)
+            continue;
+
+        // If we are holding the key down...
+        if(voice.held)
         {
-            playing = false;
-            handle_note_up();
+            voice.held = false;
+            if(voice.playing && !sustained)
+            {
+                voice.playing = false;
+                handle_note_up(v, time);
+            }
         }
     }
 }
@@ -239,14 +364,20 @@ void Vocalist::on_sustain_down(unsigned long time)
 
 void Vocalist::on_sustain_up(unsigned long time)
 {
+    if(time == 0)
+        time = get_next_time();
+
     // If we are sustaining...
     if(sustained)
     {
         sustained = false;
-        if(playing && !held) 
+        for(unsigned v = 0; v < voices.size(); v++)
         {
-            playing = false;
-            handle_note_up();
+            if(voices[v].playing && !voices[v].held) 
+            {
+                voices[v].playing = false;
+                handle_note_up(v, time);
+            }
         }
     }
 }
@@ -254,17 +385,33 @@ void Vocalist::on_sustain_up(unsigned long time)
 
 void Vocalist::on_pitch_wheel(float value, unsigned long time)
 {
+    if(time == 0)
+        time = get_next_time();
+
     // Allow a max bend of one step
     pitch_multiplier = pow(2, value * 2.0/12.0);
 
-    // Apply the bend
-    voice.set_freq(midiNoteToFreq(note) * pitch_multiplier);
+    // Apply the bend, letting a glide finish on the bent pitch. Silent
+    // voices are not rendered, and are retuned when they start
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        Voice& voice = voices[v];
+        if(voice.current_state == SILENT || voice.stealing)
+            continue;
+
+        float freq = midiNoteToFreq(voice.note) * pitch_multiplier;
+        if(time < voice.glide_end)
+            voice.source->glide_freq(freq, voice.glide_end - time, time);
+        else
+            voice.source->set_freq(freq, time);
+    }
 }
 
 void Vocalist::on_modulation_wheel(float value, unsigned long time)
 {
     // Mod wheel controls vibrato
-    voice.set_lfo_intensity(value);
+    for(unsigned v = 0; v < voices.size(); v++)
+        voices[v].source->set_lfo_intensity(value);
 }
 
 
@@ -285,7 +432,8 @@ void Vocalist::on_midi_message(std::vector<unsigned char>* message,
             case 0x17: // vibrato
             {
                 float value = (float)message->at(2) / 127;
-                voice.set_lfo_intensity(value);
+                for(unsigned v = 0; v < voices.size(); v++)
+                    voices[v].source->set_lfo_intensity(value);
                 break;
             }
             case 0x18: // tremelo
@@ -321,39 +469,50 @@ void Vocalist::on_midi_message(std::vector<unsigned char>* message,
             }
             default:
             {
-                std::cout << "Ignoring control " << message->at(1) << std::endl;
+                RtLog::info("Ignoring control 0x%02x", (unsigned) message->at(1));
             }
         }
     }
     else
     {
-        std::cout << "Unknown messsage: 0x";
-        for(int i=0; i < message->size(); i++)
-            std::cout << std::hex << std::setfill('0') << std::setw(2) << 
-                (unsigned) message->at(i);
-        std::cout << std::endl;
+        // Messages are at most three bytes
+        unsigned bytes[3] = { 0, 0, 0 };
+        for(unsigned i = 0; i < message->size() && i < 3; i++)
+            bytes[i] = message->at(i);
+
+        if(message->size() == 1)
+            RtLog::info("Unknown messsage: 0x%02x", bytes[0]);
+        else if(message->size() == 2)
+            RtLog::info("Unknown messsage: 0x%02x%02x", bytes[0], bytes[1]);
+        else
+            RtLog::info("Unknown messsage: 0x%02x%02x%02x", bytes[0],
+                    bytes[1], bytes[2]);
     }
 
 }
 
 
-void Vocalist::handle_note_down(float target_freq)
+void Vocalist::handle_note_down(unsigned v, float target_freq,
+        unsigned long time)
 {
-    // Set the frequency
+    Voice& voice = voices[v];
+
     // Handle state transition
-    switch(current_state)
+    switch(voice.current_state)
     {
         case ATTACK:
         case RELEASE:
         case SILENT:
         {
             // Handle frequnecy
-            current_freq = target_freq;
-            voice.set_freq(target_freq*pitch_multiplier);
+            voice.current_freq = target_freq;
+            voice.glide_end = 0;
+            voice.source->set_freq(target_freq*pitch_multiplier, time);
 
             // Handle state transition
-            current_state = ATTACK;
-            attack_time = get_next_time();
+            voice.current_state = ATTACK;
+            voice.attack_time = time;
+            voice.start_time = voice.attack_time;
 
             // Prepare the reflection coeffs
             Sound sound_coeffs;
@@ -384,50 +543,435 @@ void Vocalist::handle_note_down(float target_freq)
                     sound_coeffs = attack_sound;
                     break;
             }
-            gain = gains[sound_coeffs];
-            for(unsigned i = 0; i <= num_coeffs; i++)
-                reflection_coeffs[i+1] = all_coeffs[sound_coeffs][i];
+            set_sound(v, sound_coeffs);
+            start_trajectory(v, sound_coeffs);
 
             break;
         }
 
         case SUSTAIN:
         {
-            // Set up a glide to the new note
-            delta_freq = (target_freq - current_freq) / glide_duration;
-            gliding = true;
-            glide_time = get_next_time();
+            // Glide to the new note; the source ramps its own frequency
+            voice.current_freq = target_freq;
+            voice.glide_end = time + glide_duration;
+            voice.source->glide_freq(target_freq*pitch_multiplier,
+                    glide_duration, time);
             break;
         }
     }
 }
 
 
-void Vocalist::handle_note_up()
+void Vocalist::handle_note_up(unsigned v, unsigned long time)
+{
+    voices[v].current_state = RELEASE;
+    voices[v].release_time = time;
+
+    // A note released before its stolen voice faded out never starts
+    voices[v].steal_freq = 0.0;
+}
+
+
+unsigned Vocalist::allocate_voice(unsigned in_note, unsigned long time)
+{
+    // A single voice is always reused, so that overlapping notes glide
+    if(voices.size() == 1)
+        return 0;
+
+    // Prefer a voice already singing this note, and then a silent one
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        if(voices[v].note == in_note && voices[v].current_state != SILENT)
+            return v;
+    }
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        if(voices[v].current_state == SILENT)
+            return v;
+    }
+
+    // Otherwise steal one, preferring voices which are already released
+    unsigned stolen = 0;
+    for(unsigned v = 1; v < voices.size(); v++)
+    {
+        Voice& voice = voices[v];
+        Voice& best = voices[stolen];
+        if(voice.playing != best.playing)
+        {
+            if(!voice.playing)
+                stolen = v;
+            continue;
+        }
+
+        if(steal_policy == STEAL_OLDEST ?
+                voice.start_time < best.start_time :
+                voice.level < best.level)
+            stolen = v;
+    }
+
+    // Fade the stolen voice out rather than cutting it off, which would
+    // click. Its new note starts cleanly once the fade ends
+    Voice& voice = voices[stolen];
+    if(!voice.stealing)
+    {
+        voice.stealing = true;
+        voice.steal_time = time;
+    }
+
+    return stolen;
+}
+
+
+bool Vocalist::next_steal_end(unsigned long& time)
 {
-    current_state = RELEASE;
-    release_time = get_next_time();
+    bool found = false;
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        const Voice& voice = voices[v];
+        if(!voice.stealing)
+            continue;
+
+        unsigned long end = voice.steal_time + steal_duration;
+        if(!found || end < time)
+            time = end;
+        found = true;
+    }
+    return found;
+}
+
+
+void Vocalist::finish_steals(unsigned long t)
+{
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        Voice& voice = voices[v];
+        if(!voice.stealing || t < voice.steal_time + steal_duration)
+            continue;
+
+        // Silence the faded voice so that it starts its attack cleanly
+        voice.stealing = false;
+        voice.current_state = SILENT;
+        voice.glide_end = 0;
+        clear_voice(v);
+
+        if(voice.steal_freq > 0.0)
+            handle_note_down(v, voice.steal_freq, t);
+        voice.steal_freq = 0.0;
+    }
+}
+
+
+void Vocalist::pack_voices()
+{
+    // Voices which fell silent since the last piece still hold the tail of
+    // their lattice. Clear them before they are moved out of the way
+    for(unsigned v = 0; v < num_active; v++)
+    {
+        if(voices[v].current_state == SILENT)
+            clear_voice(v);
+    }
+
+    unsigned active = 0;
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        if(voices[v].current_state == SILENT)
+            continue;
+        if(v != active)
+            swap_voices(v, active);
+        active++;
+    }
+    num_active = active;
+}
+
+
+void Vocalist::swap_voices(unsigned a, unsigned b)
+{
+    std::swap(voices[a], voices[b]);
+
+    const unsigned lanes = voices.size();
+    for(unsigned i = 0; i <= num_coeffs; i++)
+    {
+        std::swap(reflection_coeffs[i*lanes + a],
+                reflection_coeffs[i*lanes + b]);
+        std::swap(reflection_coeffs_delta[i*lanes + a],
+                reflection_coeffs_delta[i*lanes + b]);
+        std::swap(backward_errors[i*lanes + a], backward_errors[i*lanes + b]);
+    }
+}
+
+
+void Vocalist::clear_voice(unsigned v)
+{
+    Voice& voice = voices[v];
+    voice.interpolating = false;
+    voice.lattice_interpolating = false;
+    voice.level = 0.0;
+
+    const unsigned lanes = voices.size();
+    for(unsigned i = 0; i <= num_coeffs; i++)
+    {
+        reflection_coeffs_delta[i*lanes + v] = 0.0;
+        backward_errors[i*lanes + v] = 0.0;
+    }
 }
 
 
 void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
 {
-    // Feed the lattice with input
-    SAMPLE voiced = voice.get_output_channel()->get_sample(t);
-    SAMPLE unvoiced = 1.0/gain * noise.get_output_channel()->get_sample(t);
+    if(t % BUFFER_SIZE == 0)
+    {
+        update_live_input(t);
+        advance_trajectories(t);
+    }
+    finish_steals(t);
+    dispatch_events(t);
+
+    vibrato_block[0] = vibrato_lfo.get_output_channel()->get_sample(t);
+    render(&output[0], 0, 1, t);
+}
+
+
+void Vocalist::generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+        unsigned long t)
+{
+    update_live_input(t);
+    advance_trajectories(t);
+    vibrato_lfo.get_output_channel()->get_block(vibrato_block, t);
+
+    // Render up to each queued event or steal, then apply it on its own
+    // sample
+    unsigned start = 0;
+    while(start < BUFFER_SIZE)
+    {
+        finish_steals(t+start);
+        dispatch_events(t+start);
+
+        unsigned end = BUFFER_SIZE;
+        unsigned long event_time;
+        if(next_event_time(event_time) && event_time < t+BUFFER_SIZE)
+        {
+            // An event may have been queued late since we dispatched
+            if(event_time <= t+start)
+                continue;
+            end = event_time - t;
+        }
+        unsigned long steal_end;
+        if(next_steal_end(steal_end) && steal_end < t+end)
+            end = steal_end - t;
+
+        render(&outputs[0][0], start, end, t);
+        start = end;
+    }
+}
+
+
+void Vocalist::render(SAMPLE* output, unsigned start, unsigned end,
+        unsigned long t)
+{
+    const unsigned lanes = voices.size();
+    const unsigned n = end - start;
+
+    // Only the sounding voices are run
+    pack_voices();
+
+    // Feed the lattices with input
+    for(unsigned v = 0; v < num_active; v++)
+    {
+        voices[v].source->render(&voiced_blocks[v][start], n, t+start,
+                &vibrato_block[start]);
+    }
+    noise.render(&unvoiced_block[start], n, t+start, NULL);
+
+    lattice_start = start;
+    lattice_end = start;
+    for(unsigned i = start; i < end; i++)
+    {
+        for(unsigned v = 0; v < num_active; v++)
+        {
+            Voice& voice = voices[v];
+            unsigned j = i*lanes + v;
+            excitation[j] = excite_sample(v, voiced_blocks[v][i],
+                    unvoiced_block[i], t+i, envelopes[j]);
+
+            // Handle reflection coefficient updates. The lattice applies them
+            // as it runs, so split the block wherever they start or stop
+            if(voice.interpolating != voice.lattice_interpolating)
+            {
+                flush_lattice();
+                if(!voice.interpolating)
+                {
+                    for(unsigned k = 1; k <= num_coeffs; k++)
+                        reflection_coeffs_delta[k*lanes + v] = 0.0;
+                }
+                voice.lattice_interpolating = voice.interpolating;
+            }
+            if(voice.interpolating)
+            {
+                // Check for state change
+                if(t+i-voice.interpolate_time >= voice.interpolate_duration)
+                    voice.interpolating = false;
+
+                voice.gain += voice.gain_delta;
+            }
+            gains_out[j] = voice.gain;
+        }
+        lattice_end = i+1;
+    }
+    flush_lattice();
+
+    // Mix the voices down
+    for(unsigned i = start; i < end; i++)
+    {
+        SAMPLE sum = 0.0;
+        for(unsigned v = 0; v < num_active; v++)
+        {
+            unsigned j = i*lanes + v;
+            sum += lattice_out[j] * gains_out[j] / 20 * envelopes[j];
+        }
+        output[i] = sum;
+    }
+
+    // Remember how loud each voice ended up, for voice stealing
+    for(unsigned v = 0; v < num_active; v++)
+    {
+        unsigned j = (end-1)*lanes + v;
+        voices[v].level = fabs(gains_out[j] * envelopes[j]);
+    }
+}
+
+
+void Vocalist::flush_lattice()
+{
+    if(lattice_end == lattice_start)
+        return;
+
+    // Voices which are not interpolating have their deltas zeroed, so the
+    // deltas only need to be applied if any voice is
+    const unsigned lanes = voices.size();
+    bool any_interpolating = false;
+    for(unsigned v = 0; v < num_active; v++)
+        any_interpolating |= voices[v].lattice_interpolating;
+
+    // Propogate the errors through the lattices of the sounding voices
+    lattice_filter(&excitation[lattice_start*lanes],
+            &lattice_out[lattice_start*lanes], lattice_end - lattice_start,
+            num_coeffs, num_active, lanes, &reflection_coeffs[0],
+            any_interpolating ? &reflection_coeffs_delta[0] : NULL,
+            &backward_errors[0]);
+    lattice_start = lattice_end;
+}
+
+
+void Vocalist::get_dependencies(std::vector<Channel*>& channels)
+{
+    channels.push_back(vibrato_lfo.get_output_channel());
+}
+
+
+void Vocalist::update_live_input(unsigned long t)
+{
+    if(live_input == NULL || !live_input->update_model())
+        return;
+
+    // Poles beyond those analyzed are left flat
+    const LpcAnalyzer::Model& model = live_input->get_model();
+    float* coeffs = coeff_table + LIVE*coeff_stride;
+    unsigned n = std::min(num_coeffs, (unsigned) model.ks.size());
+    std::copy(model.ks.begin(), model.ks.begin() + n, coeffs);
+    std::fill(coeffs + n, coeffs + num_coeffs, 0.0);
+    sound_gains[LIVE] = live_loudness *
+        sqrt(prediction_error_ratio(coeffs, num_coeffs));
+
+    // Unlike a new vowel, leave attacks and releases be, as models arrive
+    // many times a note. Attacks reach for the held sound as they end.
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        switch(voices[v].current_state)
+        {
+            case SUSTAIN:
+                interpolate_sound(v, LIVE, held_interpolate_duration, t);
+                break;
+
+            case SILENT:
+                set_sound(v, LIVE);
+                break;
+
+            default:
+                break;
+        }
+    }
+    held_sound = LIVE;
+}
+
+
+void Vocalist::start_trajectory(unsigned v, Sound sound)
+{
+    if(trajectory_frames[sound] == 0 || attack_duration == 0)
+        return;
+
+    Voice& voice = voices[v];
+    set_coeffs(v, &trajectory_table[trajectory_start[sound]], voice.gain);
+    voice.on_trajectory = true;
+    voice.trajectory = sound;
+}
+
+
+void Vocalist::advance_trajectories(unsigned long t)
+{
+    for(unsigned v = 0; v < voices.size(); v++)
+    {
+        Voice& voice = voices[v];
+        if(!voice.on_trajectory)
+            continue;
+        if(voice.current_state != ATTACK)
+        {
+            voice.on_trajectory = false;
+            continue;
+        }
+
+        // Find where the stretched trajectory is at the end of the block
+        const unsigned frames = trajectory_frames[voice.trajectory];
+        float position = 1.0*(t + BUFFER_SIZE - voice.attack_time) /
+            attack_duration * (frames-1);
+        unsigned frame = std::min((unsigned) position, frames-1);
+        unsigned next = std::min(frame+1, frames-1);
+        float alpha = std::min(position - frame, 1.0f);
+
+        const float* a = &trajectory_table[trajectory_start[voice.trajectory]
+            + frame*num_coeffs];
+        const float* b = &trajectory_table[trajectory_start[voice.trajectory]
+            + next*num_coeffs];
+        for(unsigned i = 0; i < num_coeffs; i++)
+            trajectory_target[i] = a[i] + alpha*(b[i] - a[i]);
+
+        interpolate_coeffs(v, &trajectory_target[0], voice.gain, BUFFER_SIZE,
+                t);
+    }
+}
+
+
+SAMPLE Vocalist::excite_sample(unsigned v, SAMPLE voiced,
+        SAMPLE noise_sample, unsigned long t, SAMPLE& envelope)
+{
+    Voice& voice = voices[v];
+    SAMPLE unvoiced = 1.0/voice.gain * noise_sample;
 
     SAMPLE out = 0.0;
-    SAMPLE envelope = 1.0;
-    switch(current_state)
+    envelope = 1.0;
+    switch(voice.current_state)
     {
         case ATTACK:
         {
             // Check for state transition
-            unsigned attack_t = t - attack_time;
+            unsigned attack_t = t - voice.attack_time;
             if(attack_t >= attack_duration)
-                current_state = SUSTAIN;
+                voice.current_state = SUSTAIN;
 
             float alpha = 1.0*attack_t / attack_duration;
+
+            // A trajectory ramps the voice block by block, until it hands
+            // over to the held sound
+            bool ready = !voice.interpolating || voice.on_trajectory;
             switch(attack_sound)
             {
                 case H:
@@ -443,8 +987,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                         0.7*(alpha > 0.4 ? 1.0 : alpha/0.4) * (1-alpha)*unvoiced;
 
                     // Trigger an early interpolation to target
-                    if(!interpolating && alpha > 0.85)
-                        interpolate_sound(held_sound, attack_duration*0.05);
+                    if(ready && alpha > 0.85)
+                        interpolate_sound(v, held_sound, attack_duration*0.05, t);
                     break;
 
                 case V:
@@ -453,8 +997,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = (alpha < 0.2 ? alpha/0.2 : 1.0)*voiced + 
                         0.6*(alpha < 0.4 ? alpha/0.4 : 1.0) * (1-alpha)*unvoiced;
 
-                    if(!interpolating && alpha > 0.6)
-                        interpolate_sound(held_sound, attack_duration*0.2);
+                    if(ready && alpha > 0.6)
+                        interpolate_sound(v, held_sound, attack_duration*0.2, t);
                     break;
 
                 case L:
@@ -462,8 +1006,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                 case N:
                     out = (alpha < 0.2 ? alpha/0.2 : 1.0)*voiced;
 
-                    if(!interpolating && alpha > 0.8)
-                        interpolate_sound(held_sound, attack_duration*0.2);
+                    if(ready && alpha > 0.8)
+                        interpolate_sound(v, held_sound, attack_duration*0.2, t);
                     break;
 
                 case T:
@@ -471,8 +1015,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = (alpha > 0.4 ? (alpha-0.4)/0.6 : 0.0)*voiced + 
                        (1-sqrt(alpha))*unvoiced;
 
-                    if(!interpolating && alpha > 0.7)
-                        interpolate_sound(held_sound, attack_duration*0.3);
+                    if(ready && alpha > 0.7)
+                        interpolate_sound(v, held_sound, attack_duration*0.3, t);
                     break;
 
                 case K:
@@ -480,8 +1024,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = (alpha > 0.4 ? (alpha-0.4)/0.6 : 0.0)*voiced + 
                         0.8*(1-sqrt(alpha))*unvoiced;
 
-                    if(!interpolating && alpha > 0.6)
-                        interpolate_sound(held_sound, attack_duration*0.4);
+                    if(ready && alpha > 0.6)
+                        interpolate_sound(v, held_sound, attack_duration*0.4, t);
                     break;
 
                 case P:
@@ -489,8 +1033,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = (alpha > 0.4 ? (alpha-0.4)/0.6 : 0.0)*voiced + 
                         0.4*(1-sqrt(alpha))*unvoiced;
 
-                    if(!interpolating && alpha > 0.6)
-                        interpolate_sound(held_sound, attack_duration*0.4);
+                    if(ready && alpha > 0.6)
+                        interpolate_sound(v, held_sound, attack_duration*0.4, t);
                     break;
 
                 case D:
@@ -498,8 +1042,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = voiced + 
                        0.3*(1-sqrt(alpha))*unvoiced;
 
-                    if(!interpolating && alpha > 0.3 && alpha < 0.4)
-                        interpolate_sound(held_sound, 0.3*attack_duration);
+                    if(ready && alpha > 0.3 && alpha < 0.4)
+                        interpolate_sound(v, held_sound, 0.3*attack_duration, t);
                     break;
 
                 case G:
@@ -507,8 +1051,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = voiced + 
                        0.1*(1-alpha)*unvoiced;
 
-                    if(!interpolating && alpha > 0.5 && alpha < 0.6)
-                        interpolate_sound(held_sound, 0.3*attack_duration);
+                    if(ready && alpha > 0.5 && alpha < 0.6)
+                        interpolate_sound(v, held_sound, 0.3*attack_duration, t);
                     break;
 
                 case B:
@@ -516,8 +1060,8 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
                     out = voiced + 
                        0.3*(1-alpha)*unvoiced;
 
-                    if(!interpolating && alpha > 0.6 && alpha < 0.7)
-                        interpolate_sound(held_sound, 0.3*attack_duration);
+                    if(ready && alpha > 0.6 && alpha < 0.7)
+                        interpolate_sound(v, held_sound, 0.3*attack_duration, t);
                     break;
 
                 default:
@@ -535,9 +1079,9 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
 
         case RELEASE:
         {
-            unsigned release_t = t - release_time;
+            unsigned release_t = t - voice.release_time;
             if(release_t >= release_duration)
-                current_state = SILENT;
+                voice.current_state = SILENT;
 
             envelope = 1 - ((float) release_t) / release_duration;
             out = voiced;
@@ -552,63 +1096,35 @@ void Vocalist::generate_outputs(std::vector<SAMPLE>& output, unsigned long t)
         }
     }
 
-    // Handle pitch gliding
-    if(gliding)
-    {
-        // Check for state transition
-        unsigned glide_t = t - glide_time;
-        if(glide_t >= glide_duration)
-            gliding = false;
-
-        // Continue gliding
-        current_freq += delta_freq;
-        voice.set_freq(current_freq*pitch_multiplier);
-    }
-
-    // Handle reflection coefficient updates
-    if(interpolating)
-    {
-        // Check for state change
-        if(t-interpolate_time >= interpolate_duration)
-            interpolating = false;
-
-        for(unsigned i = 1; i <= num_coeffs; i++)
-            reflection_coeffs[i] += reflection_coeffs_delta[i];
-        gain += gain_delta;
-    }
-
-    // Propogate the errors through the lattice
-    forward_errors[num_coeffs] = out;
-    for(unsigned i = num_coeffs; i > 0; i--)
+    // A stolen voice fades out on top of whatever it was doing
+    if(voice.stealing)
     {
-        forward_errors[i-1] = forward_errors[i] + 
-            reflection_coeffs[i] * backward_errors[i-1];
-        backward_errors[i] = -reflection_coeffs[i]*forward_errors[i-1] + 
-            backward_errors[i-1];
+        unsigned steal_t = t - voice.steal_time;
+        envelope *= steal_t < steal_duration ?
+            1 - ((float) steal_t) / steal_duration : 0.0;
     }
 
-    // Write the sample out
-    backward_errors[0] = forward_errors[0];
-    output[0] = forward_errors[0] * gain / 20 * envelope;
+    return out;
 }
 
 
-void Vocalist::set_hold(Sound sound)
+void Vocalist::set_hold(Sound sound, unsigned long time)
 {
     // Determine interpolation
-    switch(current_state)
+    for(unsigned v = 0; v < voices.size(); v++)
     {
-        case ATTACK:
-        case RELEASE:
-        case SILENT:
-            gain = gains[sound];
-            for(unsigned i = 0; i < num_coeffs; i++)
-                reflection_coeffs[i+1] = all_coeffs[sound][i];
-            break;
+        switch(voices[v].current_state)
+        {
+            case ATTACK:
+            case RELEASE:
+            case SILENT:
+                set_sound(v, sound);
+                break;
 
-        case SUSTAIN:
-            interpolate_sound(sound, held_interpolate_duration);
-            break;
+            case SUSTAIN:
+                interpolate_sound(v, sound, held_interpolate_duration, time);
+                break;
+        }
     }
 
     // Set sound
@@ -659,40 +1175,75 @@ void Vocalist::set_attack(Sound sound)
 }
 
 
-void Vocalist::interpolate_sound(Sound sound, unsigned duration)
+void Vocalist::set_sound(unsigned v, Sound sound)
 {
-    interpolating = true;
-    interpolate_time = get_next_time();
-    interpolate_duration = duration;
+    voices[v].on_trajectory = false;
+    set_coeffs(v, get_sound_coeffs(sound), sound_gains[sound]);
+}
+
 
+void Vocalist::interpolate_sound(unsigned v, Sound sound, unsigned duration,
+        unsigned long time)
+{
+    voices[v].on_trajectory = false;
+    interpolate_coeffs(v, get_sound_coeffs(sound), sound_gains[sound],
+            duration, time);
+}
+
+
+void Vocalist::set_coeffs(unsigned v, const float* coeffs, float gain)
+{
+    const unsigned lanes = voices.size();
+
+    voices[v].gain = gain;
     for(unsigned i = 0; i < num_coeffs; i++)
-        reflection_coeffs_delta[i+1] = 
-           (all_coeffs[sound][i] - reflection_coeffs[i+1]) / 
-           interpolate_duration;
-    gain_delta = (gains[sound] - gain) / interpolate_duration;
+        reflection_coeffs[(i+1)*lanes + v] = coeffs[i];
 }
 
 
-void Vocalist::load_sound(Sound sound, std::string file)
+void Vocalist::interpolate_coeffs(unsigned v, const float* coeffs, float gain,
+        unsigned duration, unsigned long time)
 {
-    // Open our file
-    std::fstream coeffFile;
-    coeffFile.open(file);
+    // Bring the coefficients up to date before changing their course
+    flush_lattice();
+
+    Voice& voice = voices[v];
+    voice.interpolating = true;
+    voice.interpolate_time = time;
+    voice.interpolate_duration = duration;
+
+    const unsigned lanes = voices.size();
+    float* k = &reflection_coeffs[lanes + v];
+    float* dk = &reflection_coeffs_delta[lanes + v];
+    for(unsigned i = 0; i < num_coeffs; i++)
+        dk[i*lanes] = (coeffs[i] - k[i*lanes]) / voice.interpolate_duration;
+    voice.gain_delta = (gain - voice.gain) / voice.interpolate_duration;
+}
+
 
-    // Read the header
-    std::string name;
-    coeffFile >> name; // ignore the name
-    coeffFile >> gains[sound];
-    coeffFile >> num_coeffs;
+void Vocalist::load_sound(ModelPack& model, Sound sound, std::string name)
+{
+    unsigned phoneme = model.find(name);
+    if(phoneme == model.get_num_phonemes())
+        throw ModelPackInvalid("The model pack is missing a phoneme.");
 
-    // Read the coefficients into our vector
+    sound_gains[sound] = model.get_gain(phoneme);
+    const float* coeffs = model.get_coeffs(phoneme);
     for(unsigned i = 0; i < num_coeffs; i++)
+        coeff_table[sound*coeff_stride + i] = coeffs[i];
+
+    trajectory_start[sound] = trajectory_table.size();
+    trajectory_frames[sound] = model.get_num_frames(phoneme);
+    for(unsigned f = 0; f < trajectory_frames[sound]; f++)
     {
-        float c;
-        coeffFile >> c;
-        all_coeffs[sound].push_back(c);
+        const float* frame = model.get_frame(phoneme, f);
+        trajectory_table.insert(trajectory_table.end(), frame,
+                frame + num_coeffs);
     }
+}
+
 
-    // Close the file
-    coeffFile.close();
+const float* Vocalist::get_sound_coeffs(Sound sound) const
+{
+    return coeff_table + sound*coeff_stride;
 }
@@ -1,21 +1,29 @@
 #ifndef VOCALIST_H
 #define VOCALIST_H
 
-#include <map>
 #include <string>
 #include "audio_generics.h"
 #include "gain_filter.h"
 #include "generic_instrument.h"
+#include "lpc_analyzer.h"
+#include "model_pack.h"
 #include "oscillator.h"
 
 namespace ClickTrack
 {
-    /* The vocalist is an instrument that functions like a voice
+    /* The vocalist is an instrument that functions like a voice.
+     *
+     * It may sing several notes at once, from a pool of voices allocated up
+     * front. Each voice has its own source, envelope and lattice state, and
+     * the lattices of all voices are run side by side, one voice per lane.
+     * A single voice behaves like a monophonic synth, and glides between
+     * overlapping notes.
      */
     class Vocalist : public GenericInstrument, AudioGenerator
     {
         public:
-            Vocalist();
+            Vocalist(unsigned num_voices = 1);
+            ~Vocalist();
 
             Channel* get_output_channel();
 
@@ -29,8 +37,30 @@ namespace ClickTrack
             void on_pitch_wheel(float value, unsigned long time=0);
             void on_modulation_wheel(float value, unsigned long time=0);
 
-            void handle_note_down(float target_freq);
-            void handle_note_up();
+            void handle_note_down(unsigned voice, float target_freq,
+                    unsigned long time);
+            void handle_note_up(unsigned voice, unsigned long time);
+
+            /* When every voice is in use, a new note takes over another voice.
+             * Voices that are already released are taken first, and then
+             * either the oldest voice or the quietest one.
+             */
+            enum StealPolicy { STEAL_OLDEST, STEAL_QUIETEST };
+            void set_steal_policy(StealPolicy policy);
+
+            unsigned get_num_voices();
+
+            /* Sings through the vocal tract of a live voice instead of the
+             * held vowel. Each model the analyzer fits replaces the held
+             * sound, and sustained voices glide to it as they would to a new
+             * vowel. Each is sung as loudly as the vowel held when live
+             * input was set. Pass NULL to return to that vowel.
+             *
+             * The analyzer should run in the same graph, and have as many
+             * poles as the model pack.
+             */
+            void set_live_input(LpcAnalyzer* analyzer,
+                    unsigned long time=0);
 
             /* Other MIDI messages vary from instrument to instrument. This can
              * be overriden to handle them
@@ -42,6 +72,56 @@ namespace ClickTrack
             /* Override the generator.
              */
             void generate_outputs(std::vector<SAMPLE>& output, unsigned long t);
+            void generate_block(std::vector< std::vector<SAMPLE> >& outputs,
+                    unsigned long t);
+
+            /* Helpers for the generator. render runs the sources, envelopes
+             * and lattices over samples [start, end) of the block beginning
+             * at time t. Blocks are rendered in pieces between queued events.
+             */
+            void render(SAMPLE* output, unsigned start, unsigned end,
+                    unsigned long t);
+
+            /* Computes the lattice excitation and envelope of one voice for
+             * one sample. May trigger an interpolation.
+             */
+            SAMPLE excite_sample(unsigned voice, SAMPLE voiced,
+                    SAMPLE noise_sample, unsigned long t, SAMPLE& envelope);
+
+            /* Runs the lattices over the samples excited since they were last
+             * run. Must be called before any coefficients change course.
+             */
+            void flush_lattice();
+
+            /* Picks the voice to sing a new note, stealing one if needed. A
+             * stolen voice fades out over steal_duration before its new note
+             * starts, rather than being cut off mid waveform. next_steal_end
+             * finds when the next fade ends, and finish_steals starts the
+             * notes of the voices whose fades have ended by time t.
+             */
+            unsigned allocate_voice(unsigned note, unsigned long time);
+            bool next_steal_end(unsigned long& time);
+            void finish_steals(unsigned long t);
+
+            /* Sounding voices are kept in the lowest lanes, so that silent
+             * ones cost nothing to render. pack_voices moves them there at
+             * the start of each piece, swapping whole voices and their
+             * lattices, and clears the lattice of each voice that fell
+             * silent. clear_voice drops the lattice state of one voice.
+             */
+            void pack_voices();
+            void swap_voices(unsigned a, unsigned b);
+            void clear_voice(unsigned voice);
+
+            /* The voice sources and noise are rendered directly from within
+             * our own block, in pieces between events. Only expose what they
+             * in turn depend on.
+             */
+            void get_dependencies(std::vector<Channel*>& channels);
+
+            /* Holds the latest live model, if a new one has been fit
+             */
+            void update_live_input(unsigned long time);
 
             /* Helper function for changing sound sets
              */
@@ -50,22 +130,43 @@ namespace ClickTrack
                 V, F, Z, S,       //fricatives
                 T, D, P, B, K, G, //stops
                 L, M, N,          //nasals
-                H };
-            void set_hold(Sound sound);
+                H,
+                LIVE,             //fit from live input
+                NUM_SOUNDS };
+            void set_hold(Sound sound, unsigned long time);
             void set_attack(Sound sound);
 
-            /* Helper to trigger an interpolation of the reflection coefficients
+            /* Helpers to set or to trigger an interpolation of the reflection
+             * coefficients of one voice, starting at the given time. Either
+             * takes the voice off any trajectory.
+             */
+            void set_sound(unsigned voice, Sound sound);
+            void interpolate_sound(unsigned voice, Sound sound,
+                    unsigned duration, unsigned long time);
+            void set_coeffs(unsigned voice, const float* coeffs, float gain);
+            void interpolate_coeffs(unsigned voice, const float* coeffs,
+                    float gain, unsigned duration, unsigned long time);
+
+            /* Starts a voice on the trajectory of a sound, if it has one.
+             * Once per block, advance_trajectories then ramps each attacking
+             * voice on a trajectory to where it will be at the end of the
+             * block.
+             */
+            void start_trajectory(unsigned voice, Sound sound);
+            void advance_trajectories(unsigned long t);
+
+            /* Helper function for copying sounds out of the model pack during
+             * initialization
              */
-            void interpolate_sound(Sound sound, unsigned duration);
+            void load_sound(ModelPack& model, Sound sound, std::string name);
 
-            /* Helper function for loading sounds during initialization
+            /* Gets the row of reflection coeffs for a sound
              */
-            void load_sound(Sound sound, std::string file);
+            const float* get_sound_coeffs(Sound sound) const;
 
             /* Define our signal chain
              */
             Oscillator vibrato_lfo;
-            Oscillator voice;
             Oscillator noise;
 
             Oscillator tremelo_lfo;
@@ -73,57 +174,112 @@ namespace ClickTrack
 
             /* Current note status
              */
-            unsigned note;
             float pitch_multiplier;
 
             Sound attack_sound;
             Sound held_sound;
 
-            /* Current play status
-             */
-            bool playing;
             bool sustained;
-            bool held;
+            StealPolicy steal_policy;
+
+            /* The live analyzer, the vowel it took over from, and the gain
+             * that sings a flat lattice as loudly as that vowel
+             */
+            LpcAnalyzer* live_input;
+            Sound live_return_sound;
+            float live_loudness;
 
             /* Store ADSRish parameters
              */
             float attack_modifier;
             unsigned attack_duration;
             unsigned release_duration;
+            unsigned steal_duration;
             unsigned glide_duration;
             unsigned held_interpolate_duration;
 
-            /* Store sets of reflection coeffs for each vowel
+            /* Store the reflection coeffs and gain of each sound in a dense
+             * table indexed by sound. Each row starts on a cache line. Sounds
+             * missing from the model pack are left as a flat filter of unit
+             * gain.
              */
             unsigned num_coeffs;
-            std::map<Sound, std::vector<float> > all_coeffs;
-            std::map<Sound, float> gains;
+            unsigned coeff_stride;
+            std::vector<float> coeff_storage;
+            float* coeff_table;
+            float sound_gains[NUM_SOUNDS];
+
+            /* Store the trajectory of each sound that has one, as frames of
+             * num_coeffs in a table, stretched over the attack as it plays.
+             * Targets are interpolated between frames into the scratch row.
+             */
+            std::vector<float> trajectory_table;
+            unsigned trajectory_start[NUM_SOUNDS];
+            unsigned trajectory_frames[NUM_SOUNDS];
+            std::vector<float> trajectory_target;
 
-            /* Store ADSRish state
+            /* Store the play and ADSRish state of each voice
              */
             enum State { ATTACK, SUSTAIN, RELEASE, SILENT };
-            State current_state;
+            struct Voice
+            {
+                Oscillator* source;
 
-            unsigned long attack_time;
-            unsigned long release_time;;
+                unsigned note;
+                bool playing;
+                bool held;
 
-            bool gliding;
-            unsigned long glide_time;
-            float current_freq;
-            float delta_freq;
+                State current_state;
+                unsigned long start_time;
+                unsigned long attack_time;
+                unsigned long release_time;
 
-            bool interpolating;
-            unsigned interpolate_duration;
-            unsigned interpolate_time;
-            float gain_delta;
-            std::vector<SAMPLE> reflection_coeffs_delta;
+                bool stealing;
+                unsigned long steal_time;
+                float steal_freq; // the note to start, or 0 if released
 
-            /* Store filter coefficients for the lattice
+                unsigned long glide_end;
+                float current_freq;
+
+                bool on_trajectory;
+                Sound trajectory;
+
+                bool interpolating;
+                unsigned interpolate_duration;
+                unsigned long interpolate_time;
+                float gain_delta;
+
+                float gain;
+                float level;
+
+                bool lattice_interpolating;
+            };
+            std::vector<Voice> voices;
+            unsigned num_active; // voices [0, num_active) may be sounding
+
+            /* Store filter coefficients for the lattices. Each is interleaved
+             * by voice, so value i of voice v is at index i*voices + v.
              */
-            float gain;
             std::vector<float> reflection_coeffs;
-            std::vector<SAMPLE> forward_errors;
+            std::vector<float> reflection_coeffs_delta;
             std::vector<SAMPLE> backward_errors;
+
+            /* The range of the current block the lattices have yet to run
+             * over
+             */
+            unsigned lattice_start;
+            unsigned lattice_end;
+
+            /* Statically allocated blocks for speed. All but the inputs are
+             * interleaved by voice.
+             */
+            std::vector<SAMPLE> vibrato_block;
+            std::vector< std::vector<SAMPLE> > voiced_blocks;
+            std::vector<SAMPLE> unvoiced_block;
+            std::vector<SAMPLE> excitation;
+            std::vector<SAMPLE> envelopes;
+            std::vector<SAMPLE> gains_out;
+            std::vector<SAMPLE> lattice_out;
     };
 }
 
@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "wav_reader.h"
+
+using namespace ClickTrack;
+
+
+/* Helpers to read little endian integers. Each checks that the value lies
+ * before the end.
+ */
+static const char* truncated = "The WAV file is truncated.";
+
+static uint32_t get_uint(const std::vector<unsigned char>& data,
+        unsigned long pos, unsigned bytes)
+{
+    if(pos + bytes > data.size())
+        throw WavReaderInvalid(truncated);
+
+    uint32_t value = 0;
+    for(unsigned i = 0; i < bytes; i++)
+        value |= (uint32_t) data[pos + i] << (8*i);
+    return value;
+}
+
+
+/* Decodes one sample of the given format and bit depth
+ */
+static float get_sample(const unsigned char* in, bool is_float, unsigned bits)
+{
+    if(is_float)
+    {
+        // Float samples are stored as is; this assumes a little endian
+        // machine, as WavWriter does
+        float value;
+        memcpy(&value, in, sizeof(float));
+        return value;
+    }
+
+    // 8 bit samples are unsigned, and wider ones are signed
+    if(bits == 8)
+        return (in[0] - 128) / 128.0f;
+
+    int32_t value = 0;
+    for(unsigned b = 0; b < bits/8; b++)
+        value |= (uint32_t) in[b] << (8*b + 32 - bits);
+    return value / 2147483648.0f;
+}
+
+
+std::vector<float> ClickTrack::read_wav(const std::string& path,
+        unsigned& sample_rate)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if(!file)
+        throw WavReaderInvalid("The WAV file could not be opened.");
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+
+    if(data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 ||
+            memcmp(&data[8], "WAVE", 4) != 0)
+        throw WavReaderInvalid("The file is not a WAV file.");
+
+    // Walk the chunks, looking for the format and then the data
+    unsigned format = 0, channels = 0, bits = 0;
+    unsigned long pos = 12;
+    while(true)
+    {
+        if(pos + 8 > data.size())
+            throw WavReaderInvalid("The WAV file has no data.");
+        uint32_t size = get_uint(data, pos + 4, 4);
+        unsigned long body = pos + 8;
+
+        if(memcmp(&data[pos], "fmt ", 4) == 0)
+        {
+            if(size < 16)
+                throw WavReaderInvalid(truncated);
+            format = get_uint(data, body, 2);
+            channels = get_uint(data, body + 2, 2);
+            sample_rate = get_uint(data, body + 4, 4);
+            bits = get_uint(data, body + 14, 2);
+
+            // The extensible format names the real format in its subformat
+            if(format == 0xFFFE && size >= 26)
+                format = get_uint(data, body + 24, 2);
+        }
+        else if(memcmp(&data[pos], "data", 4) == 0)
+        {
+            if(channels == 0)
+                throw WavReaderInvalid("The WAV file has no format.");
+            break;
+        }
+
+        // Chunks are padded to an even size
+        pos = body + size + (size & 1);
+    }
+
+    bool is_float = format == 3;
+    if(!(format == 1 && (bits == 8 || bits == 16 || bits == 24 ||
+                    bits == 32)) && !(is_float && bits == 32))
+        throw WavReaderInvalid("The WAV file's sample format is not supported.");
+
+    // A data chunk may be cut short by an interrupted recording; keep the
+    // frames that are there
+    unsigned long body = pos + 8;
+    unsigned long size = get_uint(data, pos + 4, 4);
+    if(body + size > data.size())
+        size = data.size() - body;
+
+    unsigned frame_size = channels * bits/8;
+    unsigned long num_frames = size / frame_size;
+    std::vector<float> samples(num_frames);
+    for(unsigned long i = 0; i < num_frames; i++)
+    {
+        const unsigned char* frame = &data[body + i*frame_size];
+        float sum = 0.0;
+        for(unsigned c = 0; c < channels; c++)
+            sum += get_sample(frame + c*bits/8, is_float, bits);
+        samples[i] = sum / channels;
+    }
+
+    return samples;
+}
@@ -0,0 +1,41 @@
+#ifndef WAV_READER_H
+#define WAV_READER_H
+
+#include <exception>
+#include <string>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* Reads a WAV file into memory, as a single channel of samples in
+     * [-1, 1]. Files with more than one channel are mixed down by averaging
+     * them. The sample rate of the file is stored in sample_rate.
+     *
+     * 8, 16, 24 and 32 bit PCM and 32 bit float files are supported,
+     * including those written by WavWriter. Chunks other than the format and
+     * data are skipped.
+     *
+     * Throws WavReaderInvalid if the file cannot be read or is malformed.
+     */
+    std::vector<float> read_wav(const std::string& path,
+            unsigned& sample_rate);
+
+
+    /* Exception thrown when a WAV file cannot be read
+     */
+    class WavReaderInvalid: public std::exception
+    {
+        public:
+            WavReaderInvalid(const char* in_reason)
+                : reason(in_reason) {}
+
+            const char* reason;
+            virtual const char* what() const throw()
+            {
+                return reason;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "wav_writer.h"
+
+using namespace ClickTrack;
+
+
+/* Helpers to write little endian integers into a byte buffer
+ */
+static char* put_u16(char* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    return out + 2;
+}
+static char* put_u32(char* out, uint32_t value)
+{
+    out = put_u16(out, value & 0xFFFF);
+    return put_u16(out, value >> 16);
+}
+
+
+/* Encodes one sample at the given bit depth
+ */
+static char* put_sample(char* out, SAMPLE sample, unsigned bits)
+{
+    // Float samples are stored as is; this assumes a little endian machine
+    if(bits == 32)
+    {
+        memcpy(out, &sample, sizeof(float));
+        return out + sizeof(float);
+    }
+
+    if(sample > 1.0) sample = 1.0;
+    if(sample < -1.0) sample = -1.0;
+    int32_t value = lrintf(sample * ((1 << (bits-1)) - 1));
+    for(unsigned b = 0; b < bits/8; b++)
+        *out++ = (value >> (8*b)) & 0xFF;
+    return out;
+}
+
+
+WavWriter::WavWriter(const std::string& path, unsigned num_inputs,
+        unsigned in_bits, unsigned long in_max_frames)
+    : AudioConsumer(num_inputs), file(), bits(in_bits),
+      max_frames(in_max_frames), frames_written(0),
+      bytes(BUFFER_SIZE * num_inputs * (in_bits/8))
+{
+    if(bits != 16 && bits != 24 && bits != 32)
+        throw WavWriterError();
+
+    file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if(!file)
+        throw WavWriterError();
+
+    // Leave room for the header, which is filled in on close
+    write_header();
+}
+
+
+WavWriter::~WavWriter()
+{
+    // A destructor must not throw, so a header that fails to write here goes
+    // unreported. Call close() first to hear about it
+    try
+    {
+        close();
+    }
+    catch(WavWriterError& e)
+    {
+    }
+}
+
+
+void WavWriter::close()
+{
+    if(!file.is_open())
+        return;
+
+    file.seekp(0);
+    write_header();
+    file.close();
+}
+
+
+unsigned long WavWriter::get_frames_written()
+{
+    return frames_written;
+}
+
+
+void WavWriter::process_inputs(std::vector<SAMPLE>& inputs, unsigned long t)
+{
+    if(max_frames != 0 && frames_written >= max_frames)
+        return;
+
+    char* out = &bytes[0];
+    for(unsigned i = 0; i < inputs.size(); i++)
+        out = put_sample(out, inputs[i], bits);
+
+    file.write(&bytes[0], out - &bytes[0]);
+    frames_written++;
+}
+
+
+void WavWriter::process_block(std::vector< std::vector<SAMPLE> >& inputs,
+        unsigned long t)
+{
+    // Stop short if this block runs past the end
+    unsigned long n = BUFFER_SIZE;
+    if(max_frames != 0 && frames_written + n > max_frames)
+        n = max_frames > frames_written ? max_frames - frames_written : 0;
+
+    // Interleave channels
+    char* out = &bytes[0];
+    for(unsigned j = 0; j < n; j++)
+    {
+        for(unsigned i = 0; i < inputs.size(); i++)
+            out = put_sample(out, inputs[i][j], bits);
+    }
+
+    file.write(&bytes[0], out - &bytes[0]);
+    frames_written += n;
+}
+
+
+void WavWriter::write_header()
+{
+    const bool is_float = bits == 32;
+    const unsigned channels = get_num_input_channels();
+    const uint32_t data_size = frames_written * channels * (bits/8);
+
+    // Float data must also carry a fact chunk
+    char header[56];
+    char* out = header;
+    memcpy(out, "RIFF", 4); out += 4;
+    out = put_u32(out, (is_float ? 48 : 36) + data_size);
+    memcpy(out, "WAVE", 4); out += 4;
+
+    memcpy(out, "fmt ", 4); out += 4;
+    out = put_u32(out, 16);
+    out = put_u16(out, is_float ? 3 : 1);
+    out = put_u16(out, channels);
+    out = put_u32(out, SAMPLE_RATE);
+    out = put_u32(out, SAMPLE_RATE * channels * (bits/8));
+    out = put_u16(out, channels * (bits/8));
+    out = put_u16(out, bits);
+
+    if(is_float)
+    {
+        memcpy(out, "fact", 4); out += 4;
+        out = put_u32(out, 4);
+        out = put_u32(out, frames_written);
+    }
+
+    memcpy(out, "data", 4); out += 4;
+    out = put_u32(out, data_size);
+
+    file.write(header, out - header);
+    if(!file)
+        throw WavWriterError();
+}
@@ -0,0 +1,72 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <exception>
+#include <fstream>
+#include <string>
+#include "audio_generics.h"
+
+
+namespace ClickTrack
+{
+    /* The WAV writer is an output device that writes its inputs to a WAV
+     * file, one channel per input, instead of playing them. It needs no audio
+     * device, so the signal chain can be rendered offline as fast as it
+     * runs.
+     *
+     * Samples are written as 16 or 24 bit PCM, clamped to [-1, 1], or as
+     * 32 bit float. The file is finished when the writer is closed or
+     * destroyed.
+     */
+    class WavWriter : public AudioConsumer
+    {
+        public:
+            /* Opens the file for writing. If max_frames is nonzero, anything
+             * consumed after that many frames is discarded. Throws
+             * WavWriterError if the file cannot be opened or the bit depth
+             * is not supported.
+             */
+            WavWriter(const std::string& path, unsigned num_inputs = 1,
+                    unsigned bits = 16, unsigned long max_frames = 0);
+            ~WavWriter();
+
+            /* Fills in the header and closes the file. Throws WavWriterError
+             * if the header cannot be written; the destructor closes the file
+             * too, but ignores the error.
+             */
+            void close();
+
+            unsigned long get_frames_written();
+
+        private:
+            void process_inputs(std::vector<SAMPLE>& inputs, unsigned long t);
+            void process_block(std::vector< std::vector<SAMPLE> >& inputs,
+                    unsigned long t);
+
+            /* Writes the header, with sizes for the frames written so far
+             */
+            void write_header();
+
+            std::ofstream file;
+            const unsigned bits;
+            const unsigned long max_frames;
+            unsigned long frames_written;
+
+            /* Statically allocated buffer of interleaved output bytes
+             */
+            std::vector<char> bytes;
+    };
+
+
+    /* Exception thrown when a WAV file cannot be written
+     */
+    class WavWriterError: public std::exception
+    {
+        virtual const char* what() const throw()
+        {
+            return "The WAV file could not be written.";
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include "wavetable.h"
+
+using namespace ClickTrack;
+
+
+const Wavetable& Wavetable::get(Shape shape)
+{
+    // Built on first use; static initialization is thread safe
+    static const Wavetable sine(Sine);
+    static const Wavetable saw(Saw);
+    static const Wavetable square(Square);
+    static const Wavetable tri(Tri);
+
+    switch(shape)
+    {
+        case Saw:    return saw;
+        case Square: return square;
+        case Tri:    return tri;
+        default:     return sine;
+    }
+}
+
+
+Wavetable::Wavetable(Shape shape)
+    : num_levels(0), samples()
+{
+    // A sine has only one harmonic, so it needs only one level
+    num_levels = 1;
+    if(shape != Sine)
+    {
+        for(unsigned h = max_harmonics; h > 1; h /= 2)
+            num_levels++;
+    }
+    samples.resize(num_levels * (table_size+1), 0.0);
+
+    // Every harmonic lands on a whole sample of one sine period
+    std::vector<double> sine(table_size);
+    for(unsigned i = 0; i < table_size; i++)
+        sine[i] = sin(2*M_PI*i / table_size);
+
+    std::vector<double> sum(table_size);
+    for(unsigned level = 0; level < num_levels; level++)
+    {
+        unsigned harmonics = shape == Sine ? 1 : max_harmonics >> level;
+        sum.assign(table_size, 0.0);
+        for(unsigned h = 1; h <= harmonics; h++)
+        {
+            // Fourier series matching the naive waveforms of the oscillator
+            double amplitude = 0.0;
+            unsigned offset = 0;
+            switch(shape)
+            {
+                case Sine:
+                    amplitude = 1.0;
+                    break;
+                case Saw:
+                    amplitude = -2/(M_PI*h);
+                    break;
+                case Square:
+                    amplitude = h % 2 ? 4/(M_PI*h) : 0.0;
+                    break;
+                case Tri:
+                    // Cosines, read from the sine a quarter period ahead
+                    amplitude = h % 2 ? -8/(M_PI*M_PI*h*h) : 0.0;
+                    offset = table_size/4;
+                    break;
+            }
+            if(amplitude == 0.0)
+                continue;
+
+            for(unsigned i = 0; i < table_size; i++)
+                sum[i] += amplitude * sine[(h*i + offset) % table_size];
+        }
+
+        float* table = &samples[level * (table_size+1)];
+        for(unsigned i = 0; i < table_size; i++)
+            table[i] = sum[i];
+        table[table_size] = table[0];
+    }
+}
+
+
+unsigned Wavetable::get_level(float phase_inc) const
+{
+    // Halve the harmonics until the highest is below Nyquist, which is
+    // pi radians per sample
+    unsigned level = 0;
+    float highest = max_harmonics * phase_inc;
+    while(highest >= M_PI && level + 1 < num_levels)
+    {
+        highest /= 2;
+        level++;
+    }
+    return level;
+}
@@ -0,0 +1,68 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <cmath>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* A wavetable holds one period of a band limited waveform, at several
+     * levels of detail like a mip map. Level k holds the harmonics up to
+     * max_harmonics >> k, so that a waveform at any pitch can be read from a
+     * level with no harmonics above the Nyquist frequency.
+     *
+     * Each shape's tables are built once, by additive synthesis, the first
+     * time they are asked for, and are shared by every oscillator. Levels are
+     * read with linear interpolation.
+     */
+    class Wavetable
+    {
+        public:
+            enum Shape { Sine, Saw, Square, Tri };
+
+            /* Gets the shared tables for a shape, building them if this is the
+             * first time. Should be called before rendering starts, since
+             * building allocates.
+             */
+            static const Wavetable& get(Shape shape);
+
+            /* Picks the most detailed level that does not alias for
+             * a waveform advancing by phase_inc radians per sample
+             */
+            unsigned get_level(float phase_inc) const;
+
+            /* Reads the given level at a phase in [0, 2pi) radians
+             */
+            inline float lookup(unsigned level, float phase) const;
+
+            static const unsigned table_size = 2048;
+            static const unsigned max_harmonics = table_size/2;
+
+        private:
+            Wavetable(Shape shape);
+
+            /* Each level holds table_size samples, plus a copy of the first
+             * so that interpolation never wraps
+             */
+            unsigned num_levels;
+            std::vector<float> samples;
+    };
+
+
+    inline float Wavetable::lookup(unsigned level, float phase) const
+    {
+        float position = phase * (table_size / (2*M_PI));
+        unsigned i = position;
+        float frac = position - i;
+
+        // Guard against a phase a hair under 2pi rounding up
+        if(i >= table_size)
+            i = table_size - 1;
+
+        const float* table = &samples[level * (table_size+1)];
+        return table[i] + frac*(table[i+1] - table[i]);
+    }
+}
+
+#endif
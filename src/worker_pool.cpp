@@ -0,0 +1,191 @@
+#include <chrono>
+#include "worker_pool.h"
+
+using namespace ClickTrack;
+
+
+WorkStealingDeque::WorkStealingDeque(unsigned capacity)
+    : top(0), bottom(0), mask(0), tasks()
+{
+    // Round up to a power of two so indices can wrap with a mask
+    unsigned long size = 1;
+    while(size < capacity)
+        size *= 2;
+
+    mask = size - 1;
+    tasks = std::vector< std::atomic<unsigned> >(size);
+}
+
+
+void WorkStealingDeque::push(unsigned task)
+{
+    long b = bottom.load(std::memory_order_relaxed);
+    tasks[b & mask].store(task, std::memory_order_relaxed);
+
+    // Publish the task before making it visible to thieves
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b+1, std::memory_order_relaxed);
+}
+
+
+bool WorkStealingDeque::pop(unsigned& task)
+{
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+
+    // Empty, restore the bottom
+    if(t > b)
+    {
+        bottom.store(b+1, std::memory_order_relaxed);
+        return false;
+    }
+
+    task = tasks[b & mask].load(std::memory_order_relaxed);
+    if(t == b)
+    {
+        // This is the last task, so race any thieves for it
+        bool won = top.compare_exchange_strong(t, t+1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b+1, std::memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+
+bool WorkStealingDeque::steal(unsigned& task)
+{
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+
+    if(t >= b)
+        return false;
+
+    task = tasks[t & mask].load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t+1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+
+
+
+WorkerPool::WorkerPool(unsigned in_num_threads, unsigned max_tasks)
+    : num_threads(in_num_threads > 0 ? in_num_threads : 1), deques(),
+      threads(), task_function(NULL), task_payload(NULL), remaining(0),
+      generation(0), stopping(false)
+{
+    for(unsigned i = 0; i < num_threads; i++)
+        deques.push_back(new WorkStealingDeque(max_tasks));
+
+    // Worker 0 is whoever calls run
+    for(unsigned i = 1; i < num_threads; i++)
+        threads.push_back(std::thread(&WorkerPool::worker_loop, this, i));
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    stopping.store(true);
+    generation.fetch_add(1);
+    for(unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    for(unsigned i = 0; i < deques.size(); i++)
+        delete deques[i];
+}
+
+
+unsigned WorkerPool::get_num_threads()
+{
+    return num_threads;
+}
+
+
+void WorkerPool::run(const std::vector<unsigned>& roots, unsigned num_tasks,
+        task_t f, void* payload)
+{
+    if(num_tasks == 0)
+        return;
+
+    // Set up the batch before any task becomes visible
+    task_function = f;
+    task_payload = payload;
+    remaining.store(num_tasks, std::memory_order_relaxed);
+    for(unsigned i = 0; i < roots.size(); i++)
+        deques[0]->push(roots[i]);
+
+    // Wake the workers and join in
+    generation.fetch_add(1, std::memory_order_release);
+    work(0);
+}
+
+
+void WorkerPool::spawn(unsigned worker, unsigned task)
+{
+    deques[worker]->push(task);
+}
+
+
+void WorkerPool::worker_loop(unsigned worker)
+{
+    unsigned long seen = 0;
+    unsigned idle = 0;
+    while(true)
+    {
+        // Wait for a new batch. Spin briefly since blocks arrive often, then
+        // back off so that idle workers do not hog their cores
+        unsigned long current = generation.load(std::memory_order_acquire);
+        if(current == seen)
+        {
+            if(++idle < 1000)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+
+        seen = current;
+        idle = 0;
+        if(stopping.load())
+            return;
+
+        work(worker);
+    }
+}
+
+
+void WorkerPool::work(unsigned worker)
+{
+    while(remaining.load(std::memory_order_acquire) > 0)
+    {
+        unsigned task;
+        if(!find_task(worker, task))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        task_function(task, worker, task_payload);
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+
+bool WorkerPool::find_task(unsigned worker, unsigned& task)
+{
+    // Prefer our own work, then try each other worker in turn
+    if(deques[worker]->pop(task))
+        return true;
+
+    for(unsigned i = 1; i < num_threads; i++)
+    {
+        if(deques[(worker + i) % num_threads]->steal(task))
+            return true;
+    }
+
+    return false;
+}
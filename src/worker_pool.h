@@ -0,0 +1,105 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace ClickTrack
+{
+    /* A work stealing deque is a fixed size queue of task numbers owned by one
+     * worker thread. The owner pushes and pops tasks from the bottom, while
+     * any other worker may steal tasks from the top. Never allocates or locks
+     * once constructed.
+     *
+     * This is the Chase-Lev deque without resizing, so it can only hold as
+     * many tasks as its capacity at once.
+     */
+    class WorkStealingDeque
+    {
+        public:
+            WorkStealingDeque(unsigned capacity);
+
+            /* Owner operations. pop returns false if the deque is empty.
+             */
+            void push(unsigned task);
+            bool pop(unsigned& task);
+
+            /* Thief operation. Returns false if the deque was empty, or if
+             * another thread won the race for the top task.
+             */
+            bool steal(unsigned& task);
+
+        private:
+            std::atomic<long> top;
+            std::atomic<long> bottom;
+
+            unsigned long mask;
+            std::vector< std::atomic<unsigned> > tasks;
+    };
+
+
+    /* The worker pool is a fixed set of threads that cooperatively run
+     * a batch of numbered tasks. The calling thread takes part as worker 0, so
+     * a pool of one thread simply runs the batch inline.
+     *
+     * Each worker has its own deque, and idle workers steal from the others.
+     * A task may spawn further tasks onto its own worker's deque. Running
+     * a batch never allocates or takes a lock, so it is safe to use from the
+     * audio thread.
+     */
+    class WorkerPool
+    {
+        public:
+            /* The callback is run once for each task, along with the index
+             * of the worker running it and the payload given to run
+             */
+            typedef void (*task_t)(unsigned task, unsigned worker,
+                    void* payload);
+
+            /* Starts the worker threads. Up to max_tasks tasks may be in
+             * flight in one batch.
+             */
+            WorkerPool(unsigned num_threads, unsigned max_tasks);
+            ~WorkerPool();
+
+            unsigned get_num_threads();
+
+            /* Runs a batch. The roots are queued first, and the call returns
+             * once num_tasks tasks have completed, including any spawned
+             * along the way.
+             */
+            void run(const std::vector<unsigned>& roots, unsigned num_tasks,
+                    task_t f, void* payload);
+
+            /* Queues another task. Must only be called from within a task,
+             * passing the worker index that task was given.
+             */
+            void spawn(unsigned worker, unsigned task);
+
+        private:
+            /* The loop run by each worker thread, and the shared helper that
+             * finds and runs tasks until the batch is complete.
+             */
+            void worker_loop(unsigned worker);
+            void work(unsigned worker);
+            bool find_task(unsigned worker, unsigned& task);
+
+            /* Per worker state. Worker 0 is the calling thread.
+             */
+            const unsigned num_threads;
+            std::vector<WorkStealingDeque*> deques;
+            std::vector<std::thread> threads;
+
+            /* The current batch. A new generation wakes the workers.
+             */
+            task_t task_function;
+            void* task_payload;
+            std::atomic<unsigned> remaining;
+            std::atomic<unsigned long> generation;
+            std::atomic<bool> stopping;
+    };
+}
+
+#endif